@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** decimator
+ **
+ ** brings the host rate down to the analysis rate by a power of two,
+ ** with a cascade of half-band FIR stages. Every other tap of a
+ ** half-band filter is zero, so each stage runs as two polyphase
+ ** branches: one dot product over the samples of the same parity and
+ ** the center tap of the others.
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_DECIMATOR_H_
+#define SRC_HEADERS_DECIMATOR_H_
+
+#include <math.h>
+#include <cstring>
+#include "pitch_kernels.h"
+
+
+/* ------------- HalfbandStage ------------- */
+
+// 4 * HALF - 1 taps, Blackman windowed sinc. Aliases landing below a
+// third of the output rate stay more than 75dB down, the ones above
+// are left to the lowpass behind the decimator.
+class HalfbandStage {
+ public:
+    enum {
+        HALF = 8,
+        TAPS = 2 * HALF,    // the nonzero taps besides the center
+    };
+
+    HalfbandStage() {
+        const int n = 4 * HALF - 1;
+        const int c = 2 * HALF - 1;
+        for (int j = 0; j < TAPS; j++) {
+            const int k = 2 * j;
+            const double x = M_PI * (k - c) / 2.0;
+            const double win = 0.42 - 0.5 * cos(2.0 * M_PI * k / (n - 1))
+                             + 0.08 * cos(4.0 * M_PI * k / (n - 1));
+            m_coef[j] = 0.5 * sin(x) / x * win;
+        }
+        // unity gain at DC, the center tap is 0.5
+        float sum = 0.0;
+        for (int j = 0; j < TAPS; j++) {
+            sum += m_coef[j];
+        }
+        for (int j = 0; j < TAPS; j++) {
+            m_coef[j] *= 0.5f / sum;
+        }
+        reset();
+    }
+
+    void reset() {
+        memset(m_same, 0, sizeof(m_same));
+        memset(m_other, 0, sizeof(m_other));
+        m_pos = 0;
+        m_otherPos = 0;
+        m_odd = false;
+    }
+
+    // take one sample, every second call y gets an output
+    bool push(const PitchKernels *k, float x, float *y) {
+        if (!m_odd) {
+            m_other[m_otherPos] = x;
+            m_otherPos = (m_otherPos + 1) % HALF;
+            m_odd = true;
+            return false;
+        }
+        m_odd = false;
+        // the line is kept twice, so the window is always contiguous
+        m_same[m_pos] = m_same[m_pos + TAPS] = x;
+        m_pos = (m_pos + 1) % TAPS;
+        // the oldest sample of m_other is the center tap, the
+        // coefficients are symmetric, so the order doesn't matter
+        *y = k->dot(m_coef, m_same + m_pos, TAPS) + 0.5f * m_other[m_otherPos];
+        return true;
+    }
+
+ private:
+    float           m_coef[TAPS];
+    float           m_same[2 * TAPS];
+    float           m_other[HALF];
+    int             m_pos;
+    int             m_otherPos;
+    bool            m_odd;
+};
+
+
+/* ------------- Decimator ------------- */
+
+class Decimator {
+ public:
+    enum { MAX_STAGES = 3 };
+
+    Decimator() : m_kernels(pitch_kernels_select()), m_stages(0), m_phase(0) {}
+
+    // decimate by 2^stages
+    void setup(int stages) {
+        m_stages = stages < MAX_STAGES ? stages : MAX_STAGES;
+        reset();
+    }
+    int factor() const { return 1 << m_stages; }
+    int stages() const { return m_stages; }
+    // input samples taken since the last output
+    int phase() const { return m_phase; }
+
+    void reset() {
+        for (int i = 0; i < MAX_STAGES; i++) {
+            m_stage[i].reset();
+        }
+        m_phase = 0;
+    }
+
+    // number of input samples which give exactly n output samples
+    int inputs_for(int n) const {
+        return n * factor() - m_phase;
+    }
+
+    // decimate count samples from input, returns the number of
+    // samples written to output
+    int process(const float *input, int count, float *output) {
+        if (!m_stages) {
+            memcpy(output, input, count * sizeof(*output));
+            return count;
+        }
+        int n = 0;
+        for (int j = 0; j < count; j++) {
+            float y = input[j];
+            int i = 0;
+            while (i < m_stages && m_stage[i].push(m_kernels, y, &y)) {
+                i++;
+            }
+            if (i == m_stages) {
+                output[n++] = y;
+            }
+        }
+        m_phase = (m_phase + count) & (factor() - 1);
+        return n;
+    }
+
+ private:
+    const PitchKernels *m_kernels;
+    int             m_stages;
+    // input samples since the last output
+    int             m_phase;
+    HalfbandStage   m_stage[MAX_STAGES];
+};
+
+
+#endif  // SRC_HEADERS_DECIMATOR_H_
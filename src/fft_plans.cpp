@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** FFT plan registry
+ **
+ ** hands out an FFTW_ESTIMATE plan pair at once and replaces it
+ ** with a measured one planned on a background thread. Wisdom is
+ ** kept in $XDG_CACHE_HOME/XTuner/, so only the first start pays
+ ** for the measurement.
+ */
+
+#include <sys/stat.h>
+
+
+FftPlanRegistry& FftPlanRegistry::instance() {
+    static FftPlanRegistry registry;
+    return registry;
+}
+
+FftPlanRegistry::FftPlanRegistry()
+    : m_exit(false),
+      m_newWisdom(false),
+      m_flags(FFTW_MEASURE),
+      m_in(0),
+      m_out(0),
+      m_scratchSize(0) {
+    std::string file = wisdom_file(false);
+    if (!file.empty()) {
+        fftwf_import_wisdom_from_filename(file.c_str());
+    }
+}
+
+FftPlanRegistry::~FftPlanRegistry() {
+    shutdown();
+    for (std::map<int, Slot*>::iterator i = m_slots.begin(); i != m_slots.end(); ++i) {
+        m_retired.push_back(i->second->load());
+        delete i->second;
+    }
+    for (size_t i = 0; i < m_retired.size(); i++) {
+        fftwf_destroy_plan(m_retired[i]->fft);
+        fftwf_destroy_plan(m_retired[i]->ifft);
+        delete m_retired[i];
+    }
+    fftwf_free(m_in);
+    fftwf_free(m_out);
+}
+
+std::string FftPlanRegistry::wisdom_file(bool create_dir) {
+    std::string path;
+    if (getenv("XDG_CACHE_HOME")) {
+        path = getenv("XDG_CACHE_HOME");
+    } else if (getenv("HOME")) {
+        path = getenv("HOME");
+        path += "/.cache";
+    } else {
+        return std::string();
+    }
+    if (create_dir) {
+        mkdir(path.c_str(), 0700);
+    }
+    path += "/XTuner";
+    if (create_dir) {
+        mkdir(path.c_str(), 0755);
+    }
+    return path + "/fftwf-wisdom";
+}
+
+// call with m_planLock held
+const FftPlanRegistry::Plans *FftPlanRegistry::make_plans(int n, unsigned int flags) {
+    if (m_scratchSize < n) {
+        fftwf_free(m_in);
+        fftwf_free(m_out);
+        m_in = reinterpret_cast<float*>(fftwf_malloc(n * sizeof(float)));
+        m_out = reinterpret_cast<float*>(fftwf_malloc(n * sizeof(float)));
+        m_scratchSize = (m_in && m_out) ? n : 0;
+        if (!m_scratchSize) {
+            return NULL;
+        }
+    }
+    fftwf_plan fft = fftwf_plan_r2r_1d(n, m_in, m_out, FFTW_R2HC, flags);
+    fftwf_plan ifft = fftwf_plan_r2r_1d(n, m_out, m_in, FFTW_HC2R, flags);
+    if (!fft || !ifft) {
+        if (fft) fftwf_destroy_plan(fft);
+        if (ifft) fftwf_destroy_plan(ifft);
+        return NULL;
+    }
+    Plans *p = new Plans;
+    p->size = n;
+    p->fft = fft;
+    p->ifft = ifft;
+    return p;
+}
+
+const FftPlanRegistry::Slot *FftPlanRegistry::get(int n) {
+    {
+        std::unique_lock<std::mutex> lk(m_lock);
+        std::map<int, Slot*>::iterator i = m_slots.find(n);
+        if (i != m_slots.end()) {
+            return i->second;
+        }
+    }
+    // a new size waits for the planner, at most for the one
+    // measurement which runs right now
+    std::unique_lock<std::mutex> plk(m_planLock);
+    std::unique_lock<std::mutex> lk(m_lock);
+    std::map<int, Slot*>::iterator i = m_slots.find(n);
+    if (i != m_slots.end()) {
+        // planned by another caller meanwhile
+        return i->second;
+    }
+    const unsigned int flags = m_flags;
+    lk.unlock();
+    // measured plans from the wisdom file, else estimate for now
+    const Plans *p = make_plans(n, flags | FFTW_WISDOM_ONLY);
+    bool measure = false;
+    if (!p) {
+        p = make_plans(n, FFTW_ESTIMATE);
+        if (!p) {
+            return NULL;
+        }
+        measure = true;
+    }
+    lk.lock();
+    Slot *slot = new Slot(p);
+    m_slots[n] = slot;
+    if (measure) {
+        m_queue.push_back(n);
+        if (!m_thread.joinable()) {
+            m_thread = std::thread(&FftPlanRegistry::run, this);
+        }
+        m_cv.notify_one();
+    }
+    return slot;
+}
+
+void FftPlanRegistry::run() {
+    std::unique_lock<std::mutex> lk(m_lock);
+    while (!m_exit) {
+        if (m_queue.empty()) {
+            m_cv.wait(lk);
+            continue;
+        }
+        int n = m_queue.front();
+        m_queue.pop_front();
+        const unsigned int flags = m_flags;
+        lk.unlock();
+        // measuring takes long, get() only waits for it when it
+        // needs the planner itself
+        const Plans *p;
+        {
+            std::unique_lock<std::mutex> plk(m_planLock);
+            p = make_plans(n, flags);
+        }
+        lk.lock();
+        if (!p) {
+            continue;
+        }
+        // the estimated plans may still be in use by a worker,
+        // keep them until exit
+        m_retired.push_back(m_slots[n]->exchange(p, std::memory_order_acq_rel));
+        m_newWisdom = true;
+    }
+}
+
+void FftPlanRegistry::shutdown() {
+    {
+        std::unique_lock<std::mutex> lk(m_lock);
+        m_exit = true;
+        m_cv.notify_one();
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    std::unique_lock<std::mutex> plk(m_planLock);
+    std::unique_lock<std::mutex> lk(m_lock);
+    if (m_newWisdom) {
+        std::string file = wisdom_file(true);
+        if (file.empty() || !fftwf_export_wisdom_to_filename(file.c_str())) {
+            fprintf(stderr, "can't save fftw wisdom to %s\n", file.c_str());
+        }
+        m_newWisdom = false;
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_FFT_PLANS_H_
+#define SRC_HEADERS_FFT_PLANS_H_
+
+#include <fftw3.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <vector>
+#include <deque>
+#include <string>
+
+
+/* ------------- FFT plan registry ------------- */
+
+// process wide store of the R2HC/HC2R plan pairs used by all
+// pitch trackers. Plans are keyed by size and executed with the
+// new-array API on the buffers of each tracker, which must be
+// allocated with fftwf_malloc and used out of place.
+class FftPlanRegistry {
+ public:
+    // forward (R2HC) and backward (HC2R) plan for one size
+    struct Plans {
+        int         size;
+        fftwf_plan  fft;
+        fftwf_plan  ifft;
+    };
+    // always holds usable plans, quickly estimated ones first, the
+    // measured plans once the background thread has them ready
+    typedef std::atomic<const Plans*> Slot;
+
+    static FftPlanRegistry& instance();
+    // get the slot for size n, returns NULL when planning failed
+    const Slot      *get(int n);
+    // plan with FFTW_PATIENT instead of FFTW_MEASURE
+    void            set_patient(bool v) {
+        std::unique_lock<std::mutex> lk(m_lock);
+        m_flags = v ? FFTW_PATIENT : FFTW_MEASURE;
+    }
+    // wait for the background thread and save the wisdom
+    void            shutdown();
+ private:
+    FftPlanRegistry();
+    ~FftPlanRegistry();
+    const Plans     *make_plans(int n, unsigned int flags);
+    void            run();
+    std::string     wisdom_file(bool create_dir);
+    std::mutex      m_planLock;         // the fftw planner is not thread safe
+    std::mutex      m_lock;             // the slots, the queue and the flags
+    std::map<int, Slot*> m_slots;
+    std::vector<const Plans*> m_retired;
+    std::deque<int> m_queue;            // sizes waiting for measurement
+    std::condition_variable m_cv;
+    std::thread     m_thread;
+    bool            m_exit;
+    bool            m_newWisdom;
+    unsigned int    m_flags;
+    float           *m_in;              // scratch arrays for planning
+    float           *m_out;
+    int             m_scratchSize;
+};
+
+
+#endif  // SRC_HEADERS_FFT_PLANS_H_
@@ -27,352 +27,986 @@
  **
  */
 
-
-// downsampling factor
-static const int DOWNSAMPLE = 2;
+// the analysis rate is the host rate divided by the largest power of
+// two (up to 8, the stages of the Decimator) which keeps it at or above
+// MIN_ANALYSIS_RATE
+static const int MIN_ANALYSIS_RATE = 20000;
 static const float SIGNAL_THRESHOLD_ON = 0.001;
 static const float SIGNAL_THRESHOLD_OFF = 0.0009;
 static const float TRACKER_PERIOD = 0.1;
-// The size of the read buffer
-static const int FFT_SIZE = 2048;
-
-
-void *PitchTracker::static_run(void *p) {
-    (reinterpret_cast<PitchTracker *>(p))->run();
-    return NULL;
-}
-
-PitchTracker::PitchTracker()
-    : error(false),
-      busy(false),
-      tick(0),
-      m_pthr(0),
-      resamp(),
+// pitch range covered by the undecimated analysis path
+static const float HIGH_RANGE_MIN = 900.0;
+static const float HIGH_RANGE_MAX = 4200.0;
+// search range and least clarity of the targeted mode
+static const float SEMITONE = 1.059463;
+static const float TARGET_CLARITY = 0.5;
+// onset detection on the decimated stream: frames of ONSET_FRAME
+// samples, an onset is a frame ONSET_RATIO times louder than the recent
+// ones, at most one per ONSET_HOLD seconds. ONSET_WINDOW seconds after
+// it an estimate is made from the new note only.
+static const int ONSET_FRAME = 128;
+static const float ONSET_RATIO = 4.0;
+static const float ONSET_HOLD = 0.1;
+static const float ONSET_WINDOW = 0.05;
+// limits for the time between estimates (in seconds)
+static const float MIN_TRACKER_PERIOD = 0.002;
+static const float MAX_TRACKER_PERIOD = 0.5;
+// analysis window sizes used by the pitch adaptive window, up to the
+// FftSize of the tracker
+static const int WINDOW_SIZES[] = { 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096 };
+static const int NUM_WINDOWS = sizeof(WINDOW_SIZES) / sizeof(WINDOW_SIZES[0]);
+// periods of the fundamental which should fit into the window
+static const float WINDOW_PERIODS = 4.0;
+// the same when the pitch filter smooths the estimates
+static const float SMOOTH_WINDOW_PERIODS = 2.5;
+// estimates within half a semitone before the window shrinks
+static const int STABLE_COUNT = 3;
+// strum mode measures the strings at most once per STRUM_INTERVAL
+// seconds, the readings are kept in between
+static const float STRUM_INTERVAL = 0.05;
+
+
+PitchTracker::PitchTracker(int fftSize, int ringSize,
+                           float *fftwBufferTime, float *fftwBufferFreq)
+    : m_maxWindow(fftSize),
+      error(false),
+      m_registered(false),
+      m_ready(false),
+      m_decimator(),
       m_sampleRate(),
-      fixed_sampleRate(41000),
+      m_lhc(),
+      m_jobs(),
+      m_buffer(),
+      m_hopCount(0),
+      m_dropped(0),
+      m_onset(0),
+      m_hasOnset(false),
+      m_onsetCount(0),
+      m_frameEnergy(0),
+      m_frameFill(0),
+      m_energyAvg(0),
+      m_sinceOnset(0),
+      m_onsetHold(0),
+      m_onsetWindow(0),
+      m_settingsSeen(0),
+      m_onsetThreshold(SIGNAL_THRESHOLD_ON),
+      m_periodFrame(0),
+      m_periodPos(0),
+      m_periodPhase(0),
+      m_periodTime(0),
+      m_periodCost(0),
+      m_sync(false),
+      m_syncBudget(0),
+      m_syncSeen(0),
+      m_syncActive(false),
+      m_syncOverruns(0),
+      m_syncCostMax(0),
+      m_syncCost(0),
       m_freq(-1),
+      m_freqFrame(0),
+      m_freqPending(false),
+      m_windows(0),
+      m_late(0),
+      m_latencyMax(0),
+      m_latencySum(0),
       signal_threshold_on(SIGNAL_THRESHOLD_ON),
       signal_threshold_off(SIGNAL_THRESHOLD_OFF),
-      tracker_period(TRACKER_PERIOD),
+      m_hopSize(0),
       m_buffersize(),
       m_fftSize(),
-      m_buffer(new float[FFT_SIZE]),
-      m_bufferIndex(0),
-      m_input(new float[FFT_SIZE]),
       m_audioLevel(false),
-      m_fftwPlanFFT(0),
-      m_fftwPlanIFFT(0) {
-    const int size = FFT_SIZE + (FFT_SIZE+1) / 2;
-    m_fftwBufferTime = reinterpret_cast<float*>
-                       (fftwf_malloc(size * sizeof(*m_fftwBufferTime)));
-    m_fftwBufferFreq = reinterpret_cast<float*>
-                       (fftwf_malloc(size * sizeof(*m_fftwBufferFreq)));
-
-    memset(m_buffer, 0, FFT_SIZE * sizeof(*m_buffer));
-    memset(m_input, 0, FFT_SIZE * sizeof(*m_input));
-    memset(m_fftwBufferTime, 0, size * sizeof(*m_fftwBufferTime));
-    memset(m_fftwBufferFreq, 0, size * sizeof(*m_fftwBufferFreq));
-
-    sem_init(&m_trig, 0, 0);
-
-    if (!m_buffer || !m_input || !m_fftwBufferTime || !m_fftwBufferFreq) {
+      m_kernels(pitch_kernels_select()),
+      m_adaptive(true),
+      m_window(0),
+      m_numWindows(0),
+      m_stableFreq(0),
+      m_stableCount(0),
+      m_extended(false),
+      m_hiSampleRate(0),
+      m_hiWindow(0),
+      m_hiPlans(0),
+      m_running(false),
+      m_target(0),
+      m_estimator(0),
+      m_strumCount(0),
+      m_strumVersion(0),
+      m_strumSeen(0),
+      m_strumEnd(0),
+      m_strumValid(false),
+      m_lastOnset(0),
+      m_smoothing(false),
+      m_clarity(0),
+      m_lastTime(0),
+      m_refine(false),
+      m_syncRequest(0),
+      m_syncVersion(0),
+      m_strobeRef(0.0),
+      m_strobe(),
+      m_strobePhases() {
+    for (int i = 0; i < MAX_STRINGS; i++) {
+        m_strumStrings[i].store(0.0, std::memory_order_relaxed);
+        m_strumFreqs[i].store(0.0, std::memory_order_relaxed);
+    }
+    m_control.version = 0;
+    m_control.sample_rate = 0;
+    m_control.period = TRACKER_PERIOD;
+    m_control.low_cut = LHC_LOW_CUT;
+    m_control.high_cut = LHC_HIGH_CUT;
+    m_control.threshold_on = SIGNAL_THRESHOLD_ON;
+    m_control.threshold_off = SIGNAL_THRESHOLD_OFF;
+    m_fftwBufferTime = fftwBufferTime;
+    m_fftwBufferFreq = fftwBufferFreq;
+
+    if (!m_buffer.init(ringSize) || !m_hiBuffer.init(ringSize)) {
         error = true;
     }
 }
 
 
 PitchTracker::~PitchTracker() {
+    // done by ~PitchTrackerT already, a worker must not see a half
+    // destroyed object
     stop_thread();
-    fftwf_destroy_plan(m_fftwPlanFFT);
-    fftwf_destroy_plan(m_fftwPlanIFFT);
-    fftwf_free(m_fftwBufferTime);
-    fftwf_free(m_fftwBufferFreq);
-    delete[] m_input;
-    delete[] m_buffer;
+}
+
+// the instances the factory can hand out. All of them decimate alike,
+// so the analysis rate only depends on the host rate and not on the
+// profile which picked the size.
+PitchTracker *PitchTracker::create(int fftSize) {
+    if (fftSize <= 1024) {
+        return new PitchTrackerT<1024>();
+    } else if (fftSize <= 2048) {
+        return new PitchTrackerT<2048>();
+    }
+    return new PitchTrackerT<4096>();
 }
 
 void PitchTracker::set_threshold(float v) {
-    signal_threshold_on = v;
-    signal_threshold_off = v*0.9;
+    std::unique_lock<std::mutex> lk(m_controlLock);
+    m_control.threshold_on = v;
+    m_control.threshold_off = v*0.9;
+    publish_settings();
 }
 
 void PitchTracker::set_fast_note_detection(bool v) {
+    std::unique_lock<std::mutex> lk(m_controlLock);
     if (v) {
-	signal_threshold_on = SIGNAL_THRESHOLD_ON * 5;
-	signal_threshold_off = SIGNAL_THRESHOLD_OFF * 5;
-	tracker_period = TRACKER_PERIOD / 10;
+	m_control.threshold_on = SIGNAL_THRESHOLD_ON * 5;
+	m_control.threshold_off = SIGNAL_THRESHOLD_OFF * 5;
+	m_control.period = TRACKER_PERIOD / 10;
     } else {
-	signal_threshold_on = SIGNAL_THRESHOLD_ON;
-	signal_threshold_off = SIGNAL_THRESHOLD_OFF;
-	tracker_period = TRACKER_PERIOD;
+	m_control.threshold_on = SIGNAL_THRESHOLD_ON;
+	m_control.threshold_off = SIGNAL_THRESHOLD_OFF;
+	m_control.period = TRACKER_PERIOD;
+    }
+    publish_settings();
+}
+
+void PitchTracker::set_band(float lowCut, float highCut) {
+    std::unique_lock<std::mutex> lk(m_controlLock);
+    m_control.low_cut = std::max(1.0f, lowCut);
+    m_control.high_cut = std::max(m_control.low_cut * 2, highCut);
+    publish_settings();
+}
+
+// new snapshot of m_control, the coefficients are computed here and
+// not on the jack thread. Called with m_controlLock held. Without a
+// rate setParameters() publishes it later.
+void PitchTracker::publish_settings() {
+    if (!m_control.sample_rate) {
+        return;
     }
+    m_control.version++;
+    lhc_design(&m_control.coefs, m_control.low_cut, m_control.high_cut, m_control.sample_rate);
+    m_settings.publish(new TrackerSettings(m_control));
+}
+
+// jack thread, take over a new snapshot. The filter state is kept.
+void PitchTracker::sync_settings() {
+    const TrackerSettings *s = m_settings.acquire(SettingsExchange::READER_JACK);
+    if (s && s->version != m_settingsSeen) {
+        m_settingsSeen = s->version;
+        m_lhc.set_coefs(0, s->coefs);
+        m_onsetThreshold = s->threshold_on;
+        // number of (decimated) samples between two analysis windows
+        int hop = static_cast<int>(s->sample_rate * s->period + 0.5);
+        m_hopSize.store(std::max(1, hop), std::memory_order_relaxed);
+    }
+    m_settings.release(SettingsExchange::READER_JACK);
+}
+
+void PitchTracker::set_hop_time(float ms) {
+    std::unique_lock<std::mutex> lk(m_controlLock);
+    m_control.period = std::max(MIN_TRACKER_PERIOD, std::min(MAX_TRACKER_PERIOD, ms * 0.001f));
+    publish_settings();
+}
+
+int PitchTracker::decimation_stages(unsigned int sampleRate) {
+    int stages = 0;
+    while (stages < Decimator::MAX_STAGES && sampleRate >> (stages + 1) >= MIN_ANALYSIS_RATE) {
+        stages++;
+    }
+    return stages;
 }
 
 bool PitchTracker::setParameters(int priority, int policy, int sampleRate, int buffersize) {
-    assert(buffersize <= FFT_SIZE);
+    assert(buffersize <= m_maxWindow);
 
     if (error) {
         return false;
     }
-    m_sampleRate = fixed_sampleRate / DOWNSAMPLE;
-    resamp.setup(sampleRate, m_sampleRate, 1, 16); // 16 == least quality
+    m_decimator.setup(decimation_stages(sampleRate));
+    m_sampleRate = sampleRate / m_decimator.factor();
+    m_lhc.init(m_sampleRate, 1);
+    m_lhc.set_flushed(RtConfig::instance().flushes_denormals());
+    {
+        // the coefficients and the hop depend on the rate
+        std::unique_lock<std::mutex> lk(m_controlLock);
+        m_control.sample_rate = m_sampleRate;
+        publish_settings();
+    }
+    m_onsetHold = static_cast<int>(ONSET_HOLD * m_sampleRate);
+    m_onsetWindow = static_cast<int>(ONSET_WINDOW * m_sampleRate);
+    m_sinceOnset = m_onsetHold;
+
+    if (m_hiSampleRate != sampleRate) {
+        // about 10ms of undecimated input for the high pitch path
+        m_hiSampleRate = sampleRate;
+        m_hiWindow = 256;
+        while (m_hiWindow < sampleRate / 100 && m_hiWindow < m_maxWindow) {
+            m_hiWindow *= 2;
+        }
+        m_hiPlans = FftPlanRegistry::instance().get(m_hiWindow + (m_hiWindow+1) / 2);
+        if (!m_hiPlans) {
+            error = true;
+            return false;
+        }
+    }
 
     if (m_buffersize != buffersize) {
         m_buffersize = buffersize;
         m_fftSize = m_buffersize + (m_buffersize+1) / 2;
-        fftwf_destroy_plan(m_fftwPlanFFT);
-        fftwf_destroy_plan(m_fftwPlanIFFT);
-        m_fftwPlanFFT = fftwf_plan_r2r_1d(
-                            m_fftSize, m_fftwBufferTime, m_fftwBufferFreq,
-                            FFTW_R2HC, FFTW_ESTIMATE);
-        m_fftwPlanIFFT = fftwf_plan_r2r_1d(
-                             m_fftSize, m_fftwBufferFreq, m_fftwBufferTime,
-                             FFTW_HC2R, FFTW_ESTIMATE);
-    }
-
-    if (!m_fftwPlanFFT || !m_fftwPlanIFFT) {
-        error = true;
-        return false;
+        // plans for all window sizes, so switching costs nothing
+        static_assert(NUM_WINDOWS <= MAX_WINDOWS, "too many window sizes");
+        m_numWindows = 0;
+        for (int i = 0; i < NUM_WINDOWS && WINDOW_SIZES[i] <= m_buffersize; i++) {
+            int n = WINDOW_SIZES[i];
+            m_plans[i] = FftPlanRegistry::instance().get(n + (n+1) / 2);
+            if (!m_plans[i]) {
+                error = true;
+                return false;
+            }
+            m_numWindows = i + 1;
+        }
+        if (!m_numWindows || WINDOW_SIZES[m_numWindows-1] != m_buffersize) {
+            error = true;
+            return false;
+        }
+        m_window = m_numWindows - 1;
     }
 
-    if (!m_pthr) {
+    if (!m_registered) {
         start_thread(priority, policy);
     }
     return !error;
 }
 
 void PitchTracker::stop_thread() {
-    pthread_cancel (m_pthr);
-    pthread_join (m_pthr, NULL);
+    if (!m_registered) {
+        return;
+    }
+    WorkerPool::instance().remove(this);
+    m_registered = false;
 }
 
+// the analysis runs on the shared pool, its workers are started
+// with policy and priority as needed
 void PitchTracker::start_thread(int priority, int policy) {
-    pthread_attr_t      attr;
-    struct sched_param  spar;
-    spar.sched_priority = priority;
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_JOINABLE );
-    pthread_setcancelstate (PTHREAD_CANCEL_ENABLE, NULL);
-    pthread_attr_setschedpolicy(&attr, policy);
-    pthread_attr_setschedparam(&attr, &spar);
-    pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
-    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-    // pthread_attr_setstacksize(&attr, 0x10000);
-    if (pthread_create(&m_pthr, &attr, static_run,
-                       reinterpret_cast<void*>(this))) {
+    if (WorkerPool::instance().add(this, policy, priority)) {
+        m_registered = true;
+    } else {
         error = true;
     }
-    pthread_attr_destroy(&attr);
 }
 
 void PitchTracker::init(int priority, int policy, unsigned int samplerate) {
-    setParameters(priority, policy, samplerate, FFT_SIZE);
+    setParameters(priority, policy, samplerate, m_maxWindow);
+    // from here on the jack thread may feed it
+    m_ready.store(!error && m_sampleRate > 0, std::memory_order_release);
 }
 
 void PitchTracker::reset() {
-    tick = 0;
-    m_bufferIndex = 0;
-    resamp.reset();
+    m_hopCount = 0;
+    m_onsetCount = 0;
+    m_decimator.reset();
+    m_lhc.clear_state();
     m_freq = -1;
 }
 
+unsigned long PitchTracker::now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+void PitchTracker::get_stats(TrackerStats *stats) {
+    stats->windows = m_windows.load(std::memory_order_relaxed);
+    stats->dropped = m_dropped.load(std::memory_order_relaxed);
+    stats->late = m_late.load(std::memory_order_relaxed);
+    stats->max_latency = m_latencyMax.load(std::memory_order_relaxed) * 0.001;
+    stats->avg_latency = stats->windows ?
+        m_latencySum.load(std::memory_order_relaxed) * 0.001 / stats->windows : 0.0;
+    stats->synchronous = m_syncActive.load(std::memory_order_relaxed);
+    stats->sync_overruns = m_syncOverruns.load(std::memory_order_relaxed);
+    stats->max_sync_cost = m_syncCostMax.load(std::memory_order_relaxed) * 0.001;
+}
+
+void PitchTracker::set_synchronous(float budget) {
+    m_syncRequest.store(std::max(0.0f, budget), std::memory_order_relaxed);
+    m_syncVersion.fetch_add(1, std::memory_order_release);
+}
+
+void PitchTracker::begin_period(unsigned int frame, int nframes, int phase) {
+    if (!m_ready.load(std::memory_order_acquire)) {
+        return;
+    }
+    m_periodFrame = frame;
+    m_periodPos = m_buffer.written();
+    m_periodPhase = phase;
+    if (m_sampleRate) {
+        m_periodTime = 1e6f * nframes / (m_sampleRate << m_decimator.stages());
+    }
+    m_periodCost = 0;
+    unsigned int v = m_syncVersion.load(std::memory_order_acquire);
+    if (v != m_syncSeen) {
+        // a new request re-arms it after an overrun
+        m_syncSeen = v;
+        m_syncBudget = m_syncRequest.load(std::memory_order_relaxed);
+        m_sync = m_syncBudget > 0;
+        m_syncCost = 0;
+        m_syncActive.store(m_sync, std::memory_order_relaxed);
+    }
+}
+
 void PitchTracker::add(int count, float* input) {
-    if (error) {
+    if (error || !m_ready.load(std::memory_order_acquire)) {
         return;
     }
-    resamp.inp_count = count;
-    resamp.inp_data = input;
-    for (;;) {
-        resamp.out_data = &m_buffer[m_bufferIndex];
-        int n = FFT_SIZE - m_bufferIndex;
-        resamp.out_count = n;
-        resamp.process();
-        n -= resamp.out_count; // n := number of output samples
-        if (!n) { // all soaked up by filter
-            return;
+    sync_settings();
+    float *io[1] = { m_scratch };
+    while (count > 0) {
+        const int in = std::min(count, m_decimator.inputs_for(SampleRing::MAX_CHUNK));
+        int n = m_decimator.process(input, in, m_scratch);
+        input += in;
+        count -= in;
+        if (n) {
+            m_lhc.compute(n, io);
+            add_decimated(n, m_scratch);
         }
-        m_bufferIndex = (m_bufferIndex + n) % FFT_SIZE;
-        if (resamp.inp_count == 0) {
-            break;
+    }
+}
+
+void PitchTracker::add_decimated(int count, const float* input) {
+    if (error || !m_ready.load(std::memory_order_acquire)) {
+        return;
+    }
+    sync_settings();
+    const int hop = m_hopSize.load(std::memory_order_relaxed);
+    if (!m_sampleRate || hop <= 0) {
+        // no window would ever fill up
+        return;
+    }
+    float strobe = m_strobeRef.load(std::memory_order_relaxed);
+    if (strobe != m_strobe.reference()) {
+        m_strobe.set_reference(strobe, m_sampleRate);
+    }
+    while (count > 0) {
+        if (m_hopCount <= 0) {
+            m_hopCount = hop;
+        }
+        unsigned int n;
+        float *out = m_buffer.write_ptr(&n);
+        // stop at the next hop, so the window ends exactly there
+        n = std::min(n, static_cast<unsigned int>(m_hopCount));
+        if (m_onsetCount > 0) {
+            n = std::min(n, static_cast<unsigned int>(m_onsetCount));
+        }
+        n = std::min(n, static_cast<unsigned int>(count));
+        memcpy(out, input, n * sizeof(*out));
+        input += n;
+        count -= n;
+        m_buffer.commit(n);
+        StrobePhase phase;
+        if (m_strobe.process(out, n, &phase)) {
+            // a GUI which doesn't read them just misses some
+            m_strobePhases.push(phase);
+        }
+        m_hopCount -= n;
+        bool fire = false;
+        if (m_onsetCount > 0) {
+            m_onsetCount -= n;
+            fire = (m_onsetCount == 0);
+        }
+        if (detect_onset(out, n)) {
+            int since = m_buffer.written() - m_onset;
+            m_onsetCount = std::max(1, m_onsetWindow - since);
+        }
+        if (fire) {
+            // restart the hops from the onset estimate
+            m_hopCount = hop;
+            trigger();
+        } else if (m_hopCount == 0) {
+            trigger();
         }
     }
-    if (++tick * count >= m_sampleRate * DOWNSAMPLE * tracker_period) {
-        if (busy) {
-            return;
+}
+
+// keep the undecimated input for the high pitch path
+void PitchTracker::add_wide(int count, float* input) {
+    if (error || !m_extended.load(std::memory_order_relaxed) || !m_ready.load(std::memory_order_acquire)) {
+        return;
+    }
+    while (count > 0) {
+        unsigned int n;
+        float *out = m_hiBuffer.write_ptr(&n);
+        n = std::min(n, static_cast<unsigned int>(count));
+        memcpy(out, input, n * sizeof(*out));
+        m_hiBuffer.commit(n);
+        input += n;
+        count -= n;
+    }
+}
+
+// energy jump detector, runs on the n samples just written to m_buffer
+// and sets m_onset to the start of the frame with the onset. An onset
+// the ring has forgotten counts as none.
+bool PitchTracker::detect_onset(const float *x, int n) {
+    bool onset = false;
+    unsigned int pos = m_buffer.written() - n;
+    for (int k = 0; k < n; k++) {
+        m_frameEnergy += sq(x[k]);
+        if (++m_frameFill < ONSET_FRAME) {
+            continue;
+        }
+        float e = m_frameEnergy / ONSET_FRAME;
+        float quiet = sq(m_onsetThreshold);
+        if (m_sinceOnset < static_cast<int>(m_buffer.size())) {
+            m_sinceOnset += ONSET_FRAME;
+        } else {
+            m_hasOnset = false;
+        }
+        if (e > quiet && e > ONSET_RATIO * m_energyAvg && m_sinceOnset >= m_onsetHold) {
+            m_onset = pos + k + 1 - ONSET_FRAME;
+            m_hasOnset = true;
+            m_sinceOnset = 0;
+            onset = true;
         }
-        busy = true;
-        tick = 0;
-        copy();
-        sem_post(&m_trig);
+        m_energyAvg += 0.3f * (e - m_energyAvg);
+        m_frameEnergy = 0.0;
+        m_frameFill = 0;
     }
+    return onset;
 }
 
-void PitchTracker::copy() {
-    int start = (FFT_SIZE + m_bufferIndex - m_buffersize) % FFT_SIZE;
-    int end = (FFT_SIZE + m_bufferIndex) % FFT_SIZE;
-    int cnt = 0;
-    if (start >= end) {
-        cnt = FFT_SIZE - start;
-        memcpy(m_input, &m_buffer[start], cnt * sizeof(*m_input));
-        start = 0;
+void PitchTracker::trigger() {
+    // the first decimated sample of the period stands for input
+    // sample factor - phase - 1 of it
+    const unsigned int frame = m_periodFrame - m_periodPhase +
+        ((m_buffer.written() - m_periodPos) << m_decimator.stages());
+    AnalysisJob job = { m_buffer.written(), m_hiBuffer.written(), m_onset, m_hasOnset, now_us(), frame };
+    if (!m_jobs.push(job)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // due before the next window comes in
+    const unsigned long hop = m_sampleRate ? 1000000UL * m_hopSize / m_sampleRate : 0;
+    if (m_sync && !worker_only() && run_synchronous()) {
+        if (m_freqPending.load(std::memory_order_relaxed)) {
+            // the signal reaches the GUI, leave that to a worker
+            WorkerPool::instance().submit(this, job.time + hop);
+        }
+        return;
     }
-    memcpy(&m_input[cnt], &m_buffer[start], (end - start) * sizeof(*m_input));
+    WorkerPool::instance().submit(this, job.time + hop);
 }
 
-inline float sq(float x) {
-    return x * x;
+// the strum scan and the zoom refiner cost several estimates, keep
+// them off the jack thread
+bool PitchTracker::worker_only() const {
+    return m_strumCount.load(std::memory_order_relaxed) ||
+        m_refine.load(std::memory_order_relaxed);
 }
 
-inline void parabolaTurningPoint(float y_1, float y0, float y1, float xOffset, float *x) {
-    float yTop = y_1 - y1;
-    float yBottom = y1 + y_1 - 2 * y0;
-    if (yBottom != 0.0) {
-        *x = xOffset + yTop / (2 * yBottom);
+// analyse the job just queued right here on the jack thread, false
+// when it doesn't fit into the budget by the cost of the last one or
+// a worker still has the tracker from before the switch
+bool PitchTracker::run_synchronous() {
+    const unsigned long budget = m_syncBudget * m_periodTime;
+    if (m_syncCost > budget) {
+        // the next windows go to the pool again
+        m_sync = false;
+        m_syncActive.store(false, std::memory_order_relaxed);
+        m_syncOverruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (m_periodCost + m_syncCost > budget) {
+        return false;
+    }
+    const unsigned long start = now_us();
+    if (!WorkerPool::instance().run_inline(this)) {
+        return false;
+    }
+    const unsigned long cost = now_us() - start;
+    if (cost > m_syncCostMax.load(std::memory_order_relaxed)) {
+        m_syncCostMax.store(cost, std::memory_order_relaxed);
+    }
+    m_syncCost = cost;
+    m_periodCost += cost;
+    if (m_periodCost > budget) {
+        m_sync = false;
+        m_syncActive.store(false, std::memory_order_relaxed);
+        m_syncOverruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// hand the new estimate to the GUI, which runs on the worker only
+void PitchTracker::publish_freq(unsigned int frame) {
+    m_freqFrame.store(frame, std::memory_order_relaxed);
+    if (running_inline()) {
+        m_freqPending.store(true, std::memory_order_relaxed);
     } else {
-        *x = xOffset;
+        new_freq();
+    }
+}
+
+bool PitchTracker::next_job(AnalysisJob& job) {
+    if (!m_jobs.pop(job)) {
+        return false;
+    }
+    // only the newest window is of interest, skip the ones
+    // which piled up while we were busy
+    AnalysisJob newer;
+    while (m_jobs.pop(newer)) {
+        job = newer;
+        m_late.fetch_add(1, std::memory_order_relaxed);
     }
+    unsigned long latency = now_us() - job.time;
+    if (latency > m_latencyMax.load(std::memory_order_relaxed)) {
+        m_latencyMax.store(latency, std::memory_order_relaxed);
+    }
+    m_latencySum.fetch_add(latency, std::memory_order_relaxed);
+    m_windows.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// the estimators selectable at runtime
+const PitchTracker::EstimatorEntry PitchTracker::estimators[] = {
+    { McLeodEstimator::name(), McLeodEstimator::adaptive(), &PitchTracker::estimate<McLeodEstimator> },
+    { YinEstimator::name(), YinEstimator::adaptive(), &PitchTracker::estimate<YinEstimator> },
+    { HpsEstimator::name(), HpsEstimator::adaptive(), &PitchTracker::estimate<HpsEstimator> },
+};
+
+int PitchTracker::estimator_count() {
+    return sizeof(estimators) / sizeof(estimators[0]);
 }
 
-static int findMaxima(float *input, int len, int *maxPositions, int *length, int maxLen) {
-    int pos = 0;
-    int curMaxPos = 0;
-    int overallMaxIndex = 0;
+const char *PitchTracker::estimator_name(int i) {
+    return (i >= 0 && i < estimator_count()) ? estimators[i].name : "";
+}
 
-    while (pos < (len-1)/3 && input[pos] > 0.0) {
-        pos += 1;  // find the first negitive zero crossing
+EstimatorContext PitchTracker::context(const FftPlanRegistry::Slot *slot, int sampleRate) {
+    // the registry may swap in measured plans at any time
+    EstimatorContext c = { m_kernels, slot->load(std::memory_order_acquire),
+                           m_fftwBufferTime, m_fftwBufferFreq, sampleRate, 0.0 };
+    return c;
+}
+
+template <class Estimator>
+float PitchTracker::estimate(const float *input, int n, const FftPlanRegistry::Slot *slot) {
+    EstimatorContext c = context(slot, m_sampleRate);
+    float x = Estimator::estimate(c, input, n);
+    m_clarity = c.clarity;
+    return x;
+}
+
+// second analysis on a short window of the undecimated input,
+// for pitches above the range of the decimated path
+float PitchTracker::find_high_pitch(unsigned int end) {
+    const float *input = m_hiBuffer.window(end, m_hiWindow);
+    // few samples per period here, the peaks are less pronounced
+    EstimatorContext c = context(m_hiPlans, m_hiSampleRate);
+    float x = McLeodEstimator::estimate(c, input, m_hiWindow, 0.9);
+    if (!m_hiBuffer.valid(end - m_hiWindow)) {
+        m_late.fetch_add(1, std::memory_order_relaxed);
+        return 0.0;
     }
-    while (pos < len-1 && input[pos] <= 0.0) {
-        pos += 1;  // loop over all the values below zero
+    if (x < HIGH_RANGE_MIN || x > HIGH_RANGE_MAX) {
+        return 0.0;
     }
-    if (pos == 0) {
-        pos = 1;  // can happen if output[0] is NAN
+    m_clarity = c.clarity;
+    return x;
+}
+
+// estimate from the running autocorrelation, brought up to end here
+// rather than per sample on the jack thread. Returns -1 when the
+// window was overwritten meanwhile, -2 when the sums aren't complete.
+float PitchTracker::find_running_pitch(unsigned int end) {
+    if (!m_acf.update(m_kernels, m_buffer, end)) {
+        return -2.0;
     }
-    while (pos < len-1) {
-        if (input[pos] > input[pos-1] && input[pos] >= input[pos+1]) {  // a local maxima
-            if (curMaxPos == 0) {
-                curMaxPos = pos;  // the first maxima (between zero crossings)
-            } else if (input[pos] > input[curMaxPos]) {
-                curMaxPos = pos;  // a higher maxima (between the zero crossings)
-            }
-        }
-        pos += 1;
-        if (pos < len-1 && input[pos] <= 0.0) {  // a negative zero crossing
-            if (curMaxPos > 0) {  // if there was a maximum
-                maxPositions[*length] = curMaxPos;  // add it to the vector of maxima
-                *length += 1;
-                if (overallMaxIndex == 0) {
-                    overallMaxIndex = curMaxPos;
-                } else if (input[curMaxPos] > input[overallMaxIndex]) {
-                    overallMaxIndex = curMaxPos;
-                }
-                if (*length >= maxLen) {
-                    return overallMaxIndex;
-                }
-                curMaxPos = 0;  // clear the maximum position, so we start looking for a new ones
-            }
-            while (pos < len-1 && input[pos] <= 0.0) {
-                pos += 1;  // loop over all the values below zero
-            }
+    const int n = RunningAcf::WINDOW + RunningAcf::LAGS;
+    const float *input = m_buffer.window(end, n);
+    int count = m_acf.nsdf(input, m_fftwBufferTime);
+    if (!m_buffer.valid(end - n)) {
+        m_late.fetch_add(1, std::memory_order_relaxed);
+        return -1.0;
+    }
+    return nsdf_pitch(m_kernels, m_fftwBufferTime, count, m_sampleRate, 0.99, &m_clarity);
+}
+
+// targeted mode, the NSDF only for the lags within a semitone of
+// target, computed directly in the time domain. Returns -1 when the
+// window was overwritten meanwhile.
+float PitchTracker::find_target_pitch(unsigned int end, float target) {
+    const int lagMin = std::max(2, static_cast<int>(m_sampleRate / (target * SEMITONE)) - 1);
+    const int lagMax = static_cast<int>(m_sampleRate * SEMITONE / target) + 2;
+    // a few periods are enough
+    int w = m_numWindows - 1;
+    for (int i = 0; i < m_numWindows; i++) {
+        if (WINDOW_SIZES[i] >= 4 * lagMax) {
+            w = i;
+            break;
         }
     }
-    if (curMaxPos > 0) {  // if there was a maximum in the last part
-        maxPositions[*length] = curMaxPos;  // add it to the vector of maxima
-        *length += 1;
-        if (overallMaxIndex == 0) {
-            overallMaxIndex = curMaxPos;
-        } else if (input[curMaxPos] > input[overallMaxIndex]) {
-            overallMaxIndex = curMaxPos;
+    const int n = WINDOW_SIZES[w];
+    if (lagMax >= n / 2) {
+        return 0.0;
+    }
+    const float *input = m_buffer.window(end, n);
+    double energy = 0.0;
+    for (int j = 0; j < n; j++) {
+        energy += sq(input[j]);
+    }
+    // energy of the samples left out at both ends at lag t
+    double cut = 0.0;
+    for (int t = 0; t < lagMin; t++) {
+        cut += sq(input[t]) + sq(input[n-1-t]);
+    }
+    float *nsdf = m_fftwBufferTime;
+    for (int t = lagMin; t <= lagMax; t++) {
+        double m = 2.0 * energy - cut;
+        float r = m_kernels->dot(input, input + t, n - t);
+        nsdf[t - lagMin] = m > 0.0 ? 2.0 * r / m : 0.0;
+        cut += sq(input[t]) + sq(input[n-1-t]);
+    }
+    if (!m_buffer.valid(end - n)) {
+        m_late.fetch_add(1, std::memory_order_relaxed);
+        return -1.0;
+    }
+    int best = 0;
+    for (int k = 1; k < lagMax - lagMin; k++) {
+        if (nsdf[k] > nsdf[k-1] && nsdf[k] >= nsdf[k+1] && (!best || nsdf[k] > nsdf[best])) {
+            best = k;
         }
-        curMaxPos = 0;  // clear the maximum position, so we start looking for a new ones
     }
-    return overallMaxIndex;
+    m_clarity = best ? nsdf[best] : 0.0;
+    if (!best || nsdf[best] < TARGET_CLARITY) {
+        return 0.0;
+    }
+    float x;
+    parabolaTurningPoint(nsdf[best-1], nsdf[best], nsdf[best+1], best + lagMin, &x);
+    return m_sampleRate / x;
 }
 
-static int findsubMaximum(float *input, int len, float threshold) {
-    int indices[10];
-    int length = 0;
-    int overallMaxIndex = findMaxima(input, len, indices, &length, 10);
-    if (length == 0) {
-        return -1;
+// sharpen the estimate x on the longest window of the current note
+// the ring holds. Returns -1 when the window was overwritten meanwhile.
+float PitchTracker::refine_pitch(unsigned int end, unsigned int fresh, float x) {
+    const int n = ZoomRefiner::window_size(x, m_sampleRate, fresh);
+    if (!n) {
+        return x;
     }
-    threshold += (1.0 - threshold) * (1.0 - input[overallMaxIndex]);
-    float cutoff = input[overallMaxIndex] * threshold;
-    for (int j = 0; j < length; j++) {
-        if (input[indices[j]] >= cutoff) {
-            return indices[j];
-        }
+    float r = m_zoom.refine(m_buffer.window(end, n), n, x, m_sampleRate);
+    if (!m_buffer.valid(end - n)) {
+        m_late.fetch_add(1, std::memory_order_relaxed);
+        return -1.0;
     }
-    // should never get here
-    return -1;
+    return r;
 }
 
-void PitchTracker::run() {
-    for (;;) {
-        busy = false;
-        sem_wait(&m_trig);
-        if (error) {
-            continue;
+// strum mode, measure all expected strings in the long window ending
+// at end. The Goertzel scan is far more expensive than an estimate, so
+// it is repeated only every STRUM_INTERVAL. Returns whether any
+// reading changed.
+bool PitchTracker::analyse_strum(unsigned int end) {
+    unsigned int version = m_strumVersion.load(std::memory_order_acquire);
+    if (end && m_strumValid && version == m_strumSeen &&
+            end - m_strumEnd < static_cast<unsigned int>(m_sampleRate * STRUM_INTERVAL)) {
+        return false;
+    }
+    m_strumEnd = end;
+    m_strumValid = (end != 0);
+    if (version != m_strumSeen) {
+        float strings[MAX_STRINGS];
+        int count = m_strumCount.load(std::memory_order_relaxed);
+        for (int i = 0; i < count; i++) {
+            strings[i] = m_strumStrings[i].load(std::memory_order_relaxed);
+        }
+        m_strum.set_strings(strings, count, m_sampleRate);
+        m_strumSeen = version;
+    }
+    float freqs[MAX_STRINGS] = { 0 };
+    if (end) {
+        const int n = StrumAnalyzer::WINDOW;
+        m_strum.analyse(m_buffer.window(end, n), freqs);
+        if (!m_buffer.valid(end - n)) {
+            m_late.fetch_add(1, std::memory_order_relaxed);
+            m_strumValid = false;
+            return false;
         }
-        float sum = 0.0;
-        for (int k = 0; k < m_buffersize; ++k) {
-            sum += fabs(m_input[k]);
+    }
+    bool changed = false;
+    for (int i = 0; i < MAX_STRINGS; i++) {
+        if (m_strumFreqs[i].load(std::memory_order_relaxed) != freqs[i]) {
+            m_strumFreqs[i].store(freqs[i], std::memory_order_relaxed);
+            changed = true;
         }
-        float threshold = (m_audioLevel ? signal_threshold_off : signal_threshold_on);
-        m_audioLevel = (sum / m_buffersize >= threshold);
-        if ( m_audioLevel == false ) {
-	    if (m_freq != 0) {
+    }
+    return changed;
+}
+
+// the newest window, runs on a worker of the pool
+void PitchTracker::process() {
+    if (!running_inline() && m_freqPending.exchange(false, std::memory_order_relaxed)) {
+        new_freq();
+    }
+    AnalysisJob job;
+    if (!next_job(job)) {
+        return;
+    }
+    if (error) {
+        return;
+    }
+    const TrackerSettings *settings = m_settings.acquire(SettingsExchange::READER_WORKER);
+    if (settings) {
+        signal_threshold_on = settings->threshold_on;
+        signal_threshold_off = settings->threshold_off;
+    }
+    m_settings.release(SettingsExchange::READER_WORKER);
+    if (job.has_onset && job.onset != m_lastOnset) {
+        // a new note, forget the stable pitch
+        m_lastOnset = job.onset;
+        adapt_window(0.0);
+    }
+    const EstimatorEntry& e = estimators[m_estimator.load(std::memory_order_relaxed)];
+    int w = e.adaptive ? m_window : m_numWindows - 1;
+    // keep the previous note out of the window
+    const unsigned int fresh = job.has_onset ? job.end - job.onset : m_buffer.size();
+    while (w > 0 && static_cast<unsigned int>(WINDOW_SIZES[w]) > fresh) {
+        w--;
+    }
+    if (static_cast<int>(fresh) < m_onsetWindow / 2) {
+        return;
+    }
+    // read straight from the ring, the window is contiguous there
+    const int n = WINDOW_SIZES[w];
+    const float *input = m_buffer.window(job.end, n);
+    float level = m_kernels->sum_abs(input, n) / n;
+    // the GUI may switch it meanwhile, this window goes one way
+    const bool extended = m_extended.load(std::memory_order_relaxed);
+    if (extended) {
+        // high notes are damped by the lowpass in front of m_buffer
+        const float *hi = m_hiBuffer.window(job.hi_end, m_hiWindow);
+        level = std::max(level, m_kernels->sum_abs(hi, m_hiWindow) / m_hiWindow);
+    }
+    float threshold = (m_audioLevel ? signal_threshold_off : signal_threshold_on);
+    m_audioLevel = (level >= threshold);
+    float dt = std::min(0.5f, (job.time - m_lastTime) * 1e-6f);
+    m_lastTime = job.time;
+    if ( m_audioLevel == false ) {
+        adapt_window(0.0);
+        m_filter.clear();
+        bool changed = analyse_strum(0);
+	    if (m_freq != 0 || changed) {
 		m_freq = 0;
-		new_freq();
+		publish_freq(job.frame);
 	    }
-            continue;
-        }
+        return;
+    }
 
-        memcpy(m_fftwBufferTime, m_input, m_buffersize * sizeof(*m_fftwBufferTime));
-        memset(m_fftwBufferTime+m_buffersize, 0, (m_fftSize - m_buffersize) * sizeof(*m_fftwBufferTime));
-        fftwf_execute(m_fftwPlanFFT);
-        for (int k = 1; k < m_fftSize/2; k++) {
-            m_fftwBufferFreq[k] = sq(m_fftwBufferFreq[k]) + sq(m_fftwBufferFreq[m_fftSize-k]);
-            m_fftwBufferFreq[m_fftSize-k] = 0.0;
+    float x;
+    float target = m_target.load(std::memory_order_relaxed);
+    if (target > 0.0) {
+        x = find_target_pitch(job.end, target);
+        if (x < 0.0) {
+            return;
         }
-        m_fftwBufferFreq[0] = sq(m_fftwBufferFreq[0]);
-        m_fftwBufferFreq[m_fftSize/2] = sq(m_fftwBufferFreq[m_fftSize/2]);
-
-        fftwf_execute(m_fftwPlanIFFT);
-
-        double sumSq = 2.0 * static_cast<double>(m_fftwBufferTime[0]) / static_cast<double>(m_fftSize);
-        for (int k = 0; k < m_fftSize - m_buffersize; k++) {
-            m_fftwBufferTime[k] = m_fftwBufferTime[k+1] / static_cast<float>(m_fftSize);
+    } else if (m_running.load(std::memory_order_relaxed) &&
+               (x = find_running_pitch(job.end)) > -2.0) {
+        if (x < 0.0) {
+            return;
         }
-
-        int count = (m_buffersize + 1) / 2;
-        for (int k = 0; k < count; k++) {
-            sumSq  -= sq(m_input[m_buffersize-1-k]) + sq(m_input[k]);
-            // dividing by zero is very slow, so deal with it seperately
-            if (sumSq > 0.0) {
-                m_fftwBufferTime[k] *= 2.0 / sumSq;
-            } else {
-                m_fftwBufferTime[k] = 0.0;
-            }
+    } else {
+        x = (this->*e.estimate)(input, n, m_plans[w]);
+        if (!m_buffer.valid(job.end - n)) {
+            // the jack thread has overwritten the window meanwhile
+            m_late.fetch_add(1, std::memory_order_relaxed);
+            return;
         }
-	const float thres = 0.99; // was 0.6
-        int maxAutocorrIndex = findsubMaximum(m_fftwBufferTime, count, thres);
-
-        float x = 0.0;
-        if (maxAutocorrIndex >= 0) {
-            parabolaTurningPoint(m_fftwBufferTime[maxAutocorrIndex-1],
-                                 m_fftwBufferTime[maxAutocorrIndex],
-                                 m_fftwBufferTime[maxAutocorrIndex+1],
-                                 maxAutocorrIndex+1, &x);
-            x = m_sampleRate / x;
-            if (x > 999.0) {  // precision drops above 1000 Hz
-                x = 0.0;
-            }
+    }
+    if (extended && target <= 0.0 && (x == 0.0 || x > HIGH_RANGE_MIN / 2)) {
+        // notes above the lowpass tend to show up an octave or more
+        // too low here, let the high rate path check them
+        float hx = find_high_pitch(job.hi_end);
+        if (hx > 0.0) {
+            x = hx;
         }
-	if (m_freq != x) {
+    }
+    if (x > 999.0 && !extended) {  // precision drops above 1000 Hz
+        x = 0.0;
+    } else if (x > HIGH_RANGE_MAX) {
+        x = 0.0;
+    }
+    adapt_window(x);
+    const bool deferred = running_inline();
+    if (x > 0.0 && x < HIGH_RANGE_MIN && !deferred && m_refine.load(std::memory_order_relaxed)) {
+        // the decimated path only, m_buffer is lowpassed
+        x = refine_pitch(job.end, fresh, x);
+        if (x < 0.0) {
+            return;
+        }
+    }
+    if (m_smoothing.load(std::memory_order_relaxed)) {
+        x = m_filter.update(x, m_clarity, dt);
+    }
+    bool changed = !deferred &&
+        analyse_strum(m_strumCount.load(std::memory_order_relaxed) ? job.end : 0);
+	if (m_freq != x || changed) {
 	    m_freq = x;
-	    new_freq();
+	    publish_freq(job.frame);
 	}
+}
+
+// Pick the window for the next estimate. Once the pitch is stable the
+// window shrinks to about WINDOW_PERIODS periods of the fundamental,
+// on silence, a missing estimate or a note change (octave jumps
+// included) the full window is used again.
+void PitchTracker::adapt_window(float x) {
+    const int full = m_numWindows - 1;
+    if (x <= 0.0 || !m_adaptive.load(std::memory_order_relaxed)) {
+        m_stableCount = 0;
+        m_window = full;
+        return;
+    }
+    if (m_stableCount == 0 || fabsf(log2f(x / m_stableFreq)) > 1.0 / 24) {
+        m_stableFreq = x;
+        m_stableCount = 1;
+        m_window = full;
+        return;
+    }
+    m_stableFreq = x;
+    if (++m_stableCount < STABLE_COUNT) {
+        return;
+    }
+    m_stableCount = STABLE_COUNT;
+    const float periods = m_smoothing.load(std::memory_order_relaxed) ?
+                          SMOOTH_WINDOW_PERIODS : WINDOW_PERIODS;
+    const float need = periods * m_sampleRate / x;
+    int w = 0;
+    while (w < full && WINDOW_SIZES[w] < need) {
+        w++;
+    }
+    if (w > m_window) {
+        m_window = w;
+    } else if (w < m_window && WINDOW_SIZES[w] >= need * 1.15) {
+        // hysteresis, only shrink with some headroom
+        m_window = w;
+    }
+}
+
+void PitchTracker::set_adaptive_window(bool v) {
+    m_adaptive.store(v, std::memory_order_relaxed);
+}
+
+void PitchTracker::set_extended_range(bool v) {
+    m_extended.store(v, std::memory_order_relaxed);
+}
+
+void PitchTracker::set_running_acf(bool v) {
+    m_running.store(v, std::memory_order_relaxed);
+}
+
+void PitchTracker::set_estimator(int i) {
+    if (i >= 0 && i < estimator_count()) {
+        m_estimator.store(i, std::memory_order_relaxed);
+    }
+}
+
+void PitchTracker::set_strum_strings(const float *freqs, int count) {
+    count = std::max(0, std::min(count, static_cast<int>(MAX_STRINGS)));
+    for (int i = 0; i < count; i++) {
+        m_strumStrings[i].store(freqs[i], std::memory_order_relaxed);
+    }
+    m_strumCount.store(count, std::memory_order_relaxed);
+    m_strumVersion.fetch_add(1, std::memory_order_release);
+}
+
+int PitchTracker::get_strum_freqs(float *freqs, int max) {
+    int count = std::min(max, m_strumCount.load(std::memory_order_relaxed));
+    for (int i = 0; i < count; i++) {
+        freqs[i] = m_strumFreqs[i].load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+void PitchTracker::set_smoothing(bool v) {
+    m_smoothing.store(v, std::memory_order_relaxed);
+}
+
+void PitchTracker::set_refine(bool v) {
+    m_refine.store(v, std::memory_order_relaxed);
+}
+
+void PitchTracker::set_strobe(float freq) {
+    m_strobeRef.store(freq, std::memory_order_relaxed);
+}
+
+bool PitchTracker::get_strobe(StrobePhase *p) {
+    bool got = false;
+    while (m_strobePhases.pop(*p)) {
+        got = true;
+    }
+    return got;
+}
+
+void PitchTracker::set_target(float freq) {
+    m_target.store(freq, std::memory_order_relaxed);
+}
+
+// everything set from outside, so a tracker for another rate or window
+// size can replace o. Call before init().
+void PitchTracker::copy_settings(PitchTracker& o) {
+    {
+        std::unique_lock<std::mutex> lk(o.m_controlLock);
+        m_control = o.m_control;
+    }
+    // published once init() gives the rate of this one
+    m_control.sample_rate = 0;
+    m_adaptive.store(o.m_adaptive.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_extended.store(o.m_extended.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_running.store(o.m_running.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_target.store(o.m_target.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_estimator.store(o.m_estimator.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_smoothing.store(o.m_smoothing.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_refine.store(o.m_refine.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_strobeRef.store(o.m_strobeRef.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    set_synchronous(o.m_syncRequest.load(std::memory_order_relaxed));
+    float strings[MAX_STRINGS];
+    int count = o.m_strumCount.load(std::memory_order_relaxed);
+    for (int i = 0; i < count; i++) {
+        strings[i] = o.m_strumStrings[i].load(std::memory_order_relaxed);
     }
+    set_strum_strings(strings, count);
 }
 
 float PitchTracker::get_estimated_note() {
@@ -26,72 +26,377 @@
 #define SRC_HEADERS_GX_PITCH_TRACKER_H_
 
 #include <assert.h>
-#include <zita-resampler/resampler.h>
+#include <stdlib.h>
 #include <fftw3.h>
-#include <semaphore.h>
 #include <sigc++/sigc++.h>
 #include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <time.h>
+
+#include "spsc_ring.h"
+#include "pitch_kernels.h"
+#include "fft_plans.h"
+#include "running_acf.h"
+#include "pitch_estimators.h"
+#include "strum_analyzer.h"
+#include "pitch_filter.h"
+#include "zoom_refiner.h"
+#include "strobe.h"
+#include "decimator.h"
+#include "lhc_bank.h"
+#include "tracker_settings.h"
+#include "worker_pool.h"
+
+
+/* ------------- Tracker statistics ------------- */
+
+struct TrackerStats {
+    // analysis windows handed to the worker
+    unsigned long   windows;
+    // windows lost because the job queue was full
+    unsigned long   dropped;
+    // windows skipped or overwritten before the worker got them
+    unsigned long   late;
+    // trigger to worker wake up time (in milliseconds)
+    float           max_latency;
+    float           avg_latency;
+    // whether the analysis runs inside the jack callback, how often it
+    // went over the budget there and its longest run (in milliseconds)
+    bool            synchronous;
+    unsigned long   sync_overruns;
+    float           max_sync_cost;
+};
 
 
 /* ------------- Pitch Tracker ------------- */
 
-class PitchTracker {
+// the sizes are fixed by PitchTrackerT, create() picks one of them
+class PitchTracker : public PoolTask {
  public:
-    PitchTracker();
-    ~PitchTracker();
+    virtual ~PitchTracker();
+    // a tracker with a largest window of at least fftSize samples,
+    // where possible
+    static PitchTracker *create(int fftSize);
     void            init(int priority, int policy, unsigned int samplerate);
     void            add(int count, float *input);
+    // feed samples already decimated to analysis_rate() and band
+    // limited, e.g. by a filter bank shared with other trackers
+    void            add_decimated(int count, const float *input);
+    int             analysis_rate() const { return m_sampleRate; }
+    // decimation for such a front end at the host rate sampleRate, the
+    // same for every tracker
+    static int      decimation_stages(unsigned int sampleRate);
+    // its band limit, jack thread only
+    LhcCoefs        band_coefs() { sync_settings(); return m_lhc.coefs(0); }
+    // feed the undecimated (unfiltered) input for the extended range
+    void            add_wide(int count, float *input);
     float           get_estimated_freq() { return m_freq < 0 ? 0 : m_freq; }
+    // jack frame just behind the window of the current estimate
+    unsigned int    get_estimate_frame() const { return m_freqFrame.load(std::memory_order_relaxed); }
+    // jack frame and length of the period whose samples come next,
+    // phase is that of the decimator in front of add_decimated()
+    void            begin_period(unsigned int frame, int nframes, int phase);
+    void            begin_period(unsigned int frame, int nframes) {
+        begin_period(frame, nframes, m_decimator.phase());
+    }
+    // analyse inside the jack callback while that takes at most budget
+    // of the period, falls back to the worker pool once it takes more.
+    // 0 always uses the pool.
+    void            set_synchronous(float budget);
     float           get_estimated_note();
     void            stop_thread();
     void            reset();
     void            set_threshold(float v);
     void            set_fast_note_detection(bool v);
+    // corners of the band limit in Hz, e.g. from an instrument profile
+    void            set_band(float lowCut, float highCut);
+    // time between two estimates, independent of the jack period
+    void            set_hop_time(float ms);
+    // shrink the window to a few periods of a stable pitch
+    void            set_adaptive_window(bool v);
+    // look for pitches up to about 4kHz in the undecimated input
+    void            set_extended_range(bool v);
+    // use the running autocorrelation instead of the FFT per window
+    void            set_running_acf(bool v);
+    // only look for a pitch within a semitone of freq, 0 to search all
+    void            set_target(float freq);
+    // estimator for the FFT windows, the running autocorrelation,
+    // the targeted mode and the high pitch path always use MPM
+    void            set_estimator(int i);
+    static int      estimator_count();
+    static const char *estimator_name(int i);
+    // smooth the published pitch with a Kalman filter, which allows
+    // shorter windows for the same steadiness
+    void            set_smoothing(bool v);
+    void            get_filter_stats(FilterStats *stats) { m_filter.get_stats(stats); }
+    // sharpen the estimates on a long window around the harmonics
+    void            set_refine(bool v);
+    // strobe readings against the reference freq, 0 switches them off
+    void            set_strobe(float freq);
+    // newest strobe reading since the last call, false if none
+    bool            get_strobe(StrobePhase *p);
+    // measure the open strings freqs all at once, next to the
+    // single pitch, count 0 switches it off
+    void            set_strum_strings(const float *freqs, int count);
+    // the measured strings, 0 for the ones which don't sound
+    int             get_strum_freqs(float *freqs, int max);
+    void            get_stats(TrackerStats *stats);
+    // take over everything set on o, before init()
+    void            copy_settings(PitchTracker& o);
    // Glib::Dispatcher new_freq;
     sigc::signal<void > new_freq;
+ protected:
+    PitchTracker(int fftSize, int ringSize,
+                 float *fftwBufferTime, float *fftwBufferFreq);
  private:
+    // a window ready for analysis, queued from add() to process()
+    struct AnalysisJob {
+        // sample position (in m_buffer) just behind the window
+        unsigned int    end;
+        // the same in m_hiBuffer
+        unsigned int    hi_end;
+        // position of the last onset in m_buffer, if has_onset
+        unsigned int    onset;
+        bool            has_onset;
+        // trigger time in microseconds
+        unsigned long   time;
+        // jack frame just behind the window
+        unsigned int    frame;
+    };
     bool            setParameters(int priority, int policy, int sampleRate, int fftSize );
-    void            run();
-    static void     *static_run(void* p);
-    void            start_thread(int policy, int priority);
-    void            copy();
+    void            process();
+    bool            pending() const {
+        return !m_jobs.empty() || m_freqPending.load(std::memory_order_relaxed);
+    }
+    void            start_thread(int priority, int policy);
+    void            publish_settings();
+    void            sync_settings();
+    void            adapt_window(float x);
+    void            trigger();
+    bool            run_synchronous();
+    bool            worker_only() const;
+    void            publish_freq(unsigned int frame);
+    bool            detect_onset(const float *x, int n);
+    bool            next_job(AnalysisJob& job);
+    struct EstimatorEntry {
+        const char  *name;
+        bool        adaptive;
+        float       (PitchTracker::*estimate)(const float *input, int n,
+                                              const FftPlanRegistry::Slot *slot);
+    };
+    static const EstimatorEntry estimators[];
+    EstimatorContext context(const FftPlanRegistry::Slot *slot, int sampleRate);
+    template <class Estimator>
+    float           estimate(const float *input, int n, const FftPlanRegistry::Slot *slot);
+    float           find_high_pitch(unsigned int end);
+    float           find_running_pitch(unsigned int end);
+    float           find_target_pitch(unsigned int end, float target);
+    float           refine_pitch(unsigned int end, unsigned int fresh, float x);
+    bool            analyse_strum(unsigned int end);
+    static unsigned long now_us();
+    // largest analysis window of the instance
+    const int       m_maxWindow;
     bool            error;
-    volatile bool   busy;
-    int             tick;
-    sem_t           m_trig;
-    pthread_t       m_pthr;
-    Resampler       resamp;
+    // known to the WorkerPool
+    bool            m_registered;
+    // set by init(), nothing is fed before
+    std::atomic<bool> m_ready;
+    // host rate down to the analysis rate m_sampleRate
+    Decimator       m_decimator;
     int             m_sampleRate;
-    int             fixed_sampleRate;
+    // band limit of the decimated signal, runs at m_sampleRate
+    LowHighCutBank  m_lhc;
+    // snapshots of the settings, m_control is the latest one and
+    // only touched under m_controlLock
+    SettingsExchange m_settings;
+    std::mutex      m_controlLock;
+    TrackerSettings m_control;
+    // decimated samples on their way to m_buffer
+    float           m_scratch[SampleRing::MAX_CHUNK];
+    // windows queued for the worker
+    SpscQueue<AnalysisJob, 8> m_jobs;
+    // The audio buffer that stores the input signal.
+    SampleRing      m_buffer;
+    // The same, undecimated for the high pitch path
+    SampleRing      m_hiBuffer;
+    // written by the jack thread only
+    char            pad0[CACHE_LINE];
+    // decimated samples left until the next analysis window
+    int             m_hopCount;
+    std::atomic<unsigned long> m_dropped;
+    // onset detector state, m_onsetCount counts down to the
+    // estimate made after an onset
+    unsigned int    m_onset;
+    bool            m_hasOnset;
+    int             m_onsetCount;
+    float           m_frameEnergy;
+    int             m_frameFill;
+    float           m_energyAvg;
+    int             m_sinceOnset;
+    // ONSET_HOLD and ONSET_WINDOW in samples of the analysis rate
+    int             m_onsetHold;
+    int             m_onsetWindow;
+    // version of the settings applied to m_lhc and the onset threshold
+    unsigned int    m_settingsSeen;
+    float           m_onsetThreshold;
+    // frame, position in m_buffer, decimator phase and length in
+    // microseconds of the current period
+    unsigned int    m_periodFrame;
+    unsigned int    m_periodPos;
+    int             m_periodPhase;
+    float           m_periodTime;
+    // time spent on analysis inside the current period
+    unsigned long   m_periodCost;
+    // synchronous mode, taken over when m_syncVersion changes
+    bool            m_sync;
+    float           m_syncBudget;
+    unsigned int    m_syncSeen;
+    std::atomic<bool> m_syncActive;
+    std::atomic<unsigned long> m_syncOverruns;
+    std::atomic<unsigned long> m_syncCostMax;
+    // cost of the last inline analysis, the estimate for the next
+    unsigned long   m_syncCost;
+    char            pad1[CACHE_LINE];
+    // written by the worker thread only
     float           m_freq;
+    std::atomic<unsigned int> m_freqFrame;
+    // an inline analysis changed the pitch, new_freq is raised by the
+    // worker trigger() hands the task to
+    std::atomic<bool> m_freqPending;
+    std::atomic<unsigned long> m_windows;
+    std::atomic<unsigned long> m_late;
+    std::atomic<unsigned long> m_latencyMax;
+    std::atomic<unsigned long> m_latencySum;
     // Value of the threshold above which
     // the processing is activated.
     float           signal_threshold_on;
     // Value of the threshold below which
     // the input audio signal is deactivated.
     float           signal_threshold_off;
-    // Time between frequency estimates (in seconds)
-    float           tracker_period;
+    char            pad2[CACHE_LINE];
+    // decimated samples between two estimates, from the period of the
+    // settings snapshot, set by the jack thread
+    std::atomic<int> m_hopSize;
     // number of samples in input buffer
     int             m_buffersize;
     // Size of the FFT window.
     int             m_fftSize;
-    // The audio buffer that stores the input signal.
-    float           *m_buffer;
-    // Index of the first empty position in the buffer.
-    int             m_bufferIndex;
-    // buffer for input signal
-    float           *m_input;
     // Whether or not the input level is high enough.
     bool            m_audioLevel;
+    // vectorised NSDF kernels for the running CPU
+    const PitchKernels *m_kernels;
     // Support buffer used to store signals in the time domain.
     float          *m_fftwBufferTime;
     // Support buffer used to store signals in the frequency domain.
     float          *m_fftwBufferFreq;
-    // Plan to compute the FFT of a given signal.
-    fftwf_plan      m_fftwPlanFFT;
-    // Plan to compute the IFFT of a given signal (with additional zero-padding).
-    fftwf_plan      m_fftwPlanIFFT;
+    // Whether the window follows the pitch, set by the GUI
+    std::atomic<bool> m_adaptive;
+    // Index of the window size used for the next estimate
+    int             m_window;
+    // Number of window sizes up to m_buffersize
+    int             m_numWindows;
+    // Last stable pitch and number of estimates it held
+    float           m_stableFreq;
+    int             m_stableCount;
+    // Plans to compute the FFT and the IFFT (with additional zero-padding)
+    // for each window size, shared with all other trackers.
+    enum { MAX_WINDOWS = 10 };
+    const FftPlanRegistry::Slot *m_plans[MAX_WINDOWS];
+    // Whether pitches above 1kHz are searched in m_hiBuffer, set by
+    // the GUI
+    std::atomic<bool> m_extended;
+    // Samplerate, window size and plans of the high pitch path
+    int             m_hiSampleRate;
+    int             m_hiWindow;
+    const FftPlanRegistry::Slot *m_hiPlans;
+    // selects the running autocorrelation, kept up to date by the worker
+    // while it is selected
+    std::atomic<bool> m_running;
+    RunningAcf      m_acf;
+    // expected pitch of the targeted mode or 0
+    std::atomic<float> m_target;
+    // index into estimators
+    std::atomic<int> m_estimator;
+    // strum mode, the strings are set by the GUI and taken over by
+    // the worker when m_strumVersion changes
+    enum { MAX_STRINGS = StrumAnalyzer::MAX_STRINGS };
+    std::atomic<float> m_strumStrings[MAX_STRINGS];
+    std::atomic<int> m_strumCount;
+    std::atomic<unsigned int> m_strumVersion;
+    unsigned int    m_strumSeen;
+    // end of the window of the last strum readings, if valid
+    unsigned int    m_strumEnd;
+    bool            m_strumValid;
+    StrumAnalyzer   m_strum;
+    std::atomic<float> m_strumFreqs[MAX_STRINGS];
+    // the onset the stable pitch belongs to
+    unsigned int    m_lastOnset;
+    // smoothing of the published pitch
+    std::atomic<bool> m_smoothing;
+    PitchFilter     m_filter;
+    // clarity of the last estimate and time of the last job
+    float           m_clarity;
+    unsigned long   m_lastTime;
+    // sub-cent refinement of the decimated path
+    std::atomic<bool> m_refine;
+    ZoomRefiner     m_zoom;
+    // budget for the synchronous mode, set by set_synchronous()
+    std::atomic<float> m_syncRequest;
+    std::atomic<unsigned int> m_syncVersion;
+    // strobe, demodulated by the jack thread, read by the GUI
+    std::atomic<float> m_strobeRef;
+    StrobeDemodulator m_strobe;
+    SpscQueue<StrobePhase, 64> m_strobePhases;
+};
+
+
+
+/* ------------- PitchTrackerT ------------- */
+
+// largest window FftSize (at the analysis rate). The FFT buffers are part of the object, which operator
+// new puts on a cache line, at least the alignment the shared plans
+// were made for with fftwf_malloc.
+// The per-window loops stay in the base class on the SIMD kernels
+// picked at runtime. Scalar loops over a constant FftSize, unrolled
+// and vectorised by the compiler for the baseline SSE, took 2.5 to 4
+// times as long (sum_abs, dot, fold_power at 2048 and 3072 samples).
+template <int FftSize>
+class PitchTrackerT : public PitchTracker {
+ public:
+    static_assert(FftSize >= 1024 && FftSize <= 4096 && !(FftSize & (FftSize - 1)),
+                  "FftSize must be a power of two from 1024 to 4096");
+    enum {
+        // the largest window zero padded
+        BUFFER_SIZE = FftSize + (FftSize + 1) / 2,
+        // history for FftSize and the strum and zoom windows
+        RING_SIZE = 4 * (FftSize > 2048 ? FftSize : 2048),
+    };
+
+    PitchTrackerT()
+        : PitchTracker(FftSize, RING_SIZE, m_timeBuffer, m_freqBuffer) {
+        memset(m_timeBuffer, 0, sizeof(m_timeBuffer));
+        memset(m_freqBuffer, 0, sizeof(m_freqBuffer));
+    }
+    // off the pool before the buffers and the vptr go, a worker may
+    // be in process() right now
+    ~PitchTrackerT() { stop_thread(); }
+
+    // plain new only aligns to 16 bytes before C++17
+    static void *operator new(size_t n) {
+        void *p;
+        if (posix_memalign(&p, alignof(PitchTrackerT), n)) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+    static void operator delete(void *p) { free(p); }
+
+ private:
+    alignas(64) float m_timeBuffer[BUFFER_SIZE];
+    alignas(64) float m_freqBuffer[BUFFER_SIZE];
 };
 
 
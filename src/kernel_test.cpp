@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+
+/****************************************************************
+ ** kernel test
+ **
+ ** checks the SIMD kernels against their scalar reference, all
+ ** sets the running CPU supports, and the filter bank against
+ ** low_high_cut::Dsp. Built and run by make test, exits non-zero
+ ** on a mismatch.
+ */
+
+#include <stdint.h>
+#include "pitch_kernels.h"
+#include "lhc_bank.h"
+#include "low_high_cut.cc"
+
+
+// scalar reference of the peak picking in pitch_kernels.h
+static int findMaxima(const float *input, int len, int *maxPositions, int *length, int maxLen) {
+    int pos = 0;
+    int curMaxPos = 0;
+    int overallMaxIndex = 0;
+
+    while (pos < (len-1)/3 && input[pos] > 0.0) {
+        pos += 1;  // find the first negitive zero crossing
+    }
+    while (pos < len-1 && input[pos] <= 0.0) {
+        pos += 1;  // loop over all the values below zero
+    }
+    if (pos == 0) {
+        pos = 1;  // can happen if output[0] is NAN
+    }
+    while (pos < len-1) {
+        if (input[pos] > input[pos-1] && input[pos] >= input[pos+1]) {  // a local maxima
+            if (curMaxPos == 0) {
+                curMaxPos = pos;  // the first maxima (between zero crossings)
+            } else if (input[pos] > input[curMaxPos]) {
+                curMaxPos = pos;  // a higher maxima (between the zero crossings)
+            }
+        }
+        pos += 1;
+        if (pos < len-1 && input[pos] <= 0.0) {  // a negative zero crossing
+            if (curMaxPos > 0) {  // if there was a maximum
+                maxPositions[*length] = curMaxPos;  // add it to the vector of maxima
+                *length += 1;
+                if (overallMaxIndex == 0) {
+                    overallMaxIndex = curMaxPos;
+                } else if (input[curMaxPos] > input[overallMaxIndex]) {
+                    overallMaxIndex = curMaxPos;
+                }
+                if (*length >= maxLen) {
+                    return overallMaxIndex;
+                }
+                curMaxPos = 0;  // clear the maximum position, so we start looking for a new ones
+            }
+            while (pos < len-1 && input[pos] <= 0.0) {
+                pos += 1;  // loop over all the values below zero
+            }
+        }
+    }
+    if (curMaxPos > 0) {  // if there was a maximum in the last part
+        maxPositions[*length] = curMaxPos;  // add it to the vector of maxima
+        *length += 1;
+        if (overallMaxIndex == 0) {
+            overallMaxIndex = curMaxPos;
+        } else if (input[curMaxPos] > input[overallMaxIndex]) {
+            overallMaxIndex = curMaxPos;
+        }
+        curMaxPos = 0;  // clear the maximum position, so we start looking for a new ones
+    }
+    return overallMaxIndex;
+}
+
+// compare the kernels k against the scalar reference
+static bool test_pitch_kernels(const PitchKernels *k) {
+    const int n = 3072;
+    const int w = 2048;
+    float *a = new float[n];
+    float *b = new float[n];
+    float *in = new float[w];
+    bool ok = true;
+    srand(1);
+    for (int i = 0; i < w; i++) {
+        in[i] = sinf(i * 0.05f) * 0.5f + (rand() / (float)RAND_MAX - 0.5f) * 0.1f;
+    }
+    for (int i = 0; i < n; i++) {
+        a[i] = b[i] = rand() / (float)RAND_MAX - 0.5f;
+    }
+    if (fabs(k->sum_abs(in, w) - sum_abs_ref(in, w)) > 1e-3) {
+        ok = false;
+    }
+    k->fold_power(a, n);
+    fold_power_ref(b, n);
+    for (int i = 0; i < n; i++) {
+        ok = ok && fabs(a[i] - b[i]) <= 1e-6 * (1.0 + fabs(b[i]));
+    }
+    k->shift_scale(a, n - w, 0.5f);
+    shift_scale_ref(b, n - w, 0.5f);
+    for (int i = 0; i < n; i++) {
+        ok = ok && a[i] == b[i];
+    }
+    double sumSq = 0.0;
+    for (int i = 0; i < w; i++) {
+        sumSq += 2.0 * sq(in[i]);
+        a[i] = b[i] = in[i];
+    }
+    k->normalize(a, in, w, (w+1)/2, sumSq);
+    normalize_ref(b, in, w, (w+1)/2, sumSq);
+    for (int i = 0; i < (w+1)/2; i++) {
+        ok = ok && fabs(a[i] - b[i]) <= 1e-4 * (1.0 + fabs(b[i]));
+    }
+    double da[64], db[64];
+    for (int i = 0; i < 64; i++) {
+        da[i] = db[i] = i;
+    }
+    k->acf_update(da, in, in + 100, 0.3f, -0.7f, 61);
+    acf_update_ref(db, in, in + 100, 0.3f, -0.7f, 61);
+    for (int i = 0; i < 64; i++) {
+        ok = ok && fabs(da[i] - db[i]) <= 1e-12;
+    }
+    ok = ok && fabs(k->dot(in, in + 7, w - 7) - dot_ref(in, in + 7, w - 7)) <= 1e-3;
+    int ia[10], ib[10];
+    int la = 0, lb = 0;
+    int ma = findMaxima(k, b, (w+1)/2, ia, &la, 10);
+    int mb = findMaxima(b, (w+1)/2, ib, &lb, 10);
+    ok = ok && ma == mb && la == lb;
+    for (int i = 0; ok && i < la; i++) {
+        ok = ia[i] == ib[i];
+    }
+    printf("pitch tracker kernels: %s %s\n", k->name, ok ? "ok" : "FAILED");
+    delete[] a;
+    delete[] b;
+    delete[] in;
+    return ok;
+}
+
+// compare the filter bank kernels k against low_high_cut::Dsp
+static bool test_lhc_bank(const LhcBankKernels *k) {
+    const int channels = 11;
+    const int count = 4096;
+    const int rate = 24000;
+    LowHighCutBank bank(k);
+    bank.init(rate, channels);
+    low_high_cut::Dsp ref;
+    float *io[channels];
+    float *expect = new float[count];
+    bool ok = true;
+    srand(2);
+    for (int ch = 0; ch < channels; ch++) {
+        io[ch] = new float[count];
+        for (int i = 0; i < count; i++) {
+            io[ch][i] = 0.5f * sinf(i * 0.01f * (ch + 1)) + (rand() / (float)RAND_MAX - 0.5f) * 0.2f;
+        }
+    }
+    // two blocks, so the state is carried over once
+    bank.compute(count / 2, io);
+    float *second[channels];
+    for (int ch = 0; ch < channels; ch++) {
+        second[ch] = io[ch] + count / 2;
+    }
+    bank.compute(count - count / 2, second);
+    srand(2);
+    for (int ch = 0; ch < channels; ch++) {
+        for (int i = 0; i < count; i++) {
+            expect[i] = 0.5f * sinf(i * 0.01f * (ch + 1)) + (rand() / (float)RAND_MAX - 0.5f) * 0.2f;
+        }
+        low_high_cut::Dsp::init_static(rate, &ref);
+        low_high_cut::Dsp::compute_static(count, expect, expect, &ref);
+        for (int i = 0; i < count; i++) {
+            ok = ok && fabsf(io[ch][i] - expect[i]) <= 1e-4f;
+        }
+        delete[] io[ch];
+    }
+    delete[] expect;
+    // a band of its own on each channel, against the scalar reference
+    // filtering one channel at a time
+    LowHighCutBank own(k);
+    own.init(rate, channels);
+    float *ref_io[channels];
+    for (int ch = 0; ch < channels; ch++) {
+        LhcCoefs c;
+        lhc_design(&c, 20.0f + 10.0f * ch, 300.0f + 150.0f * ch, rate);
+        own.set_coefs(ch, c);
+        io[ch] = new float[count];
+        ref_io[ch] = new float[count];
+        for (int i = 0; i < count; i++) {
+            io[ch][i] = ref_io[ch][i] = rand() / (float)RAND_MAX - 0.5f;
+        }
+    }
+    own.compute(count, io);
+    for (int ch = 0; ch < channels; ch++) {
+        LowHighCutBank one(&lhc_bank_ref);
+        one.init(rate, 1);
+        one.set_coefs(0, own.coefs(ch));
+        one.compute(count, &ref_io[ch]);
+        for (int i = 0; i < count; i++) {
+            ok = ok && fabsf(io[ch][i] - ref_io[ch][i]) <= 1e-5f;
+        }
+        delete[] io[ch];
+        delete[] ref_io[ch];
+    }
+    printf("low/high cut bank: %s %s\n", k->name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main() {
+    bool ok = test_pitch_kernels(&pitch_kernels_ref);
+#if defined(__SSE2__)
+    ok = test_pitch_kernels(&pitch_kernels_sse2) && ok;
+#endif
+#if defined(PITCH_KERNELS_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        ok = test_pitch_kernels(&pitch_kernels_avx2) && ok;
+    }
+#endif
+    ok = test_lhc_bank(&lhc_bank_ref) && ok;
+#if defined(__SSE2__)
+    ok = test_lhc_bank(&lhc_bank_sse2) && ok;
+#endif
+#if defined(PITCH_KERNELS_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        ok = test_lhc_bank(&lhc_bank_avx2) && ok;
+    }
+#endif
+    printf("the pitch tracker uses %s, the filter bank %s\n",
+           pitch_kernels_select()->name, lhc_bank_select()->name);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** low/high cut filter bank
+ **
+ ** the filter of low_high_cut::Dsp in single precision for up to
+ ** MAX_CHANNELS channels at once. The state is kept as structure of
+ ** arrays, one row per state variable with a lane per channel, so
+ ** 4 (SSE2) or 8 (AVX2) channels run in lockstep. The coefficients
+ ** are kept the same way, so each channel has its own band. The state stays in
+ ** registers for a whole block. low_high_cut::Dsp is kept as the
+ ** reference, see kernel_test.cpp.
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_LHC_BANK_H_
+#define SRC_HEADERS_LHC_BANK_H_
+
+#include <math.h>
+#include <cstring>
+#include <algorithm>
+#include "pitch_kernels.h"
+
+
+// coefficients, named after the constants of low_high_cut::Dsp
+struct LhcCoefs {
+    float   c3, c4, c6, c7, c8, c9, c10;
+};
+
+// rows of the state
+enum {
+    LHC_X,          // previous input of the first highpass
+    LHC_HP1,        // first highpass
+    LHC_HP2,        // second highpass
+    LHC_LP1A,       // first lowpass section, one and two samples back
+    LHC_LP1B,
+    LHC_LP2A,       // second lowpass section
+    LHC_LP2B,
+    LHC_ROWS,
+};
+
+// rows of the coefficients
+enum {
+    LHC_C3,
+    LHC_C4,
+    LHC_C6,
+    LHC_C7,
+    LHC_C8,
+    LHC_C9,
+    LHC_C10,
+    LHC_COEF_ROWS,
+};
+
+struct LhcBankKernels {
+    const char *name;
+    // filter count samples of the channels io[0 .. channels) in place,
+    // coefs holds LHC_COEF_ROWS and state LHC_ROWS rows of stride floats,
+    // dn is the anti-denormal signal, 0 when the cpu flushes them
+    void (*run)(const float *coefs, float *state, int stride, float *const *io,
+                int channels, int count, float dn);
+};
+
+// tiny signal against denormals, it alternates per sample, so the
+// highpass passes it and the lowpass zero at nyquist removes it
+static const float LHC_ANTI_DENORMAL = 1e-20f;
+
+/* ------------- scalar reference ------------- */
+
+static void lhc_run_ref(const float *coefs, float *state, int stride, float *const *io,
+                        int channels, int count, float dn) {
+    for (int ch = 0; ch < channels; ch++) {
+        const float *k = coefs + ch;
+        const float c3 = k[LHC_C3 * stride], c4 = k[LHC_C4 * stride];
+        const float c6 = k[LHC_C6 * stride], c7 = k[LHC_C7 * stride];
+        const float c8 = k[LHC_C8 * stride], c9 = k[LHC_C9 * stride];
+        const float c10 = k[LHC_C10 * stride];
+        float *s = state + ch;
+        float xp = s[LHC_X * stride], hp1 = s[LHC_HP1 * stride], hp2 = s[LHC_HP2 * stride];
+        float a1 = s[LHC_LP1A * stride], b1 = s[LHC_LP1B * stride];
+        float a2 = s[LHC_LP2A * stride], b2 = s[LHC_LP2B * stride];
+        float d = dn;
+        float *x = io[ch];
+        for (int i = 0; i < count; i++) {
+            const float in = x[i] + d;
+            d = -d;
+            const float h1 = c6 * ((in - xp) + c7 * hp1);
+            const float h2 = c6 * ((h1 - hp1) + c7 * hp2);
+            const float r1 = h2 - c4 * (c8 * b1 + c9 * a1);
+            const float y1 = c4 * (b1 + r1 + 2.0f * a1);
+            const float r0 = y1 - c3 * (c10 * b2 + c9 * a2);
+            x[i] = c3 * (b2 + r0 + 2.0f * a2);
+            xp = in;
+            hp1 = h1;
+            hp2 = h2;
+            b1 = a1;
+            a1 = r1;
+            b2 = a2;
+            a2 = r0;
+        }
+        s[LHC_X * stride] = xp;
+        s[LHC_HP1 * stride] = hp1;
+        s[LHC_HP2 * stride] = hp2;
+        s[LHC_LP1A * stride] = a1;
+        s[LHC_LP1B * stride] = b1;
+        s[LHC_LP2A * stride] = a2;
+        s[LHC_LP2B * stride] = b2;
+    }
+}
+
+/* ------------- SSE2 ------------- */
+
+#if defined(__SSE2__)
+
+static void lhc_run_sse2(const float *coefs, float *state, int stride, float *const *io,
+                         int channels, int count, float dn) {
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 flip = _mm_set1_ps(-1.0f);
+    int ch = 0;
+    for (; ch + 4 <= channels; ch += 4) {
+        const float *k = coefs + ch;
+        const __m128 c3 = _mm_loadu_ps(k + LHC_C3 * stride), c4 = _mm_loadu_ps(k + LHC_C4 * stride);
+        const __m128 c6 = _mm_loadu_ps(k + LHC_C6 * stride), c7 = _mm_loadu_ps(k + LHC_C7 * stride);
+        const __m128 c8 = _mm_loadu_ps(k + LHC_C8 * stride), c9 = _mm_loadu_ps(k + LHC_C9 * stride);
+        const __m128 c10 = _mm_loadu_ps(k + LHC_C10 * stride);
+        float *s = state + ch;
+        __m128 xp = _mm_loadu_ps(s + LHC_X * stride);
+        __m128 hp1 = _mm_loadu_ps(s + LHC_HP1 * stride);
+        __m128 hp2 = _mm_loadu_ps(s + LHC_HP2 * stride);
+        __m128 a1 = _mm_loadu_ps(s + LHC_LP1A * stride);
+        __m128 b1 = _mm_loadu_ps(s + LHC_LP1B * stride);
+        __m128 a2 = _mm_loadu_ps(s + LHC_LP2A * stride);
+        __m128 b2 = _mm_loadu_ps(s + LHC_LP2B * stride);
+        __m128 d = _mm_set1_ps(dn);
+        float *x0 = io[ch], *x1 = io[ch+1], *x2 = io[ch+2], *x3 = io[ch+3];
+        for (int i = 0; i < count; i++) {
+            const __m128 in = _mm_add_ps(_mm_setr_ps(x0[i], x1[i], x2[i], x3[i]), d);
+            d = _mm_mul_ps(d, flip);
+            const __m128 h1 = _mm_mul_ps(c6, _mm_add_ps(_mm_sub_ps(in, xp), _mm_mul_ps(c7, hp1)));
+            const __m128 h2 = _mm_mul_ps(c6, _mm_add_ps(_mm_sub_ps(h1, hp1), _mm_mul_ps(c7, hp2)));
+            const __m128 r1 = _mm_sub_ps(h2, _mm_mul_ps(c4, _mm_add_ps(_mm_mul_ps(c8, b1), _mm_mul_ps(c9, a1))));
+            const __m128 y1 = _mm_mul_ps(c4, _mm_add_ps(_mm_add_ps(b1, r1), _mm_mul_ps(two, a1)));
+            const __m128 r0 = _mm_sub_ps(y1, _mm_mul_ps(c3, _mm_add_ps(_mm_mul_ps(c10, b2), _mm_mul_ps(c9, a2))));
+            const __m128 y = _mm_mul_ps(c3, _mm_add_ps(_mm_add_ps(b2, r0), _mm_mul_ps(two, a2)));
+            float t[4];
+            _mm_storeu_ps(t, y);
+            x0[i] = t[0];
+            x1[i] = t[1];
+            x2[i] = t[2];
+            x3[i] = t[3];
+            xp = in;
+            hp1 = h1;
+            hp2 = h2;
+            b1 = a1;
+            a1 = r1;
+            b2 = a2;
+            a2 = r0;
+        }
+        _mm_storeu_ps(s + LHC_X * stride, xp);
+        _mm_storeu_ps(s + LHC_HP1 * stride, hp1);
+        _mm_storeu_ps(s + LHC_HP2 * stride, hp2);
+        _mm_storeu_ps(s + LHC_LP1A * stride, a1);
+        _mm_storeu_ps(s + LHC_LP1B * stride, b1);
+        _mm_storeu_ps(s + LHC_LP2A * stride, a2);
+        _mm_storeu_ps(s + LHC_LP2B * stride, b2);
+    }
+    lhc_run_ref(coefs + ch, state + ch, stride, io + ch, channels - ch, count, dn);
+}
+
+#endif  // __SSE2__
+
+/* ------------- AVX2 ------------- */
+
+#if defined(PITCH_KERNELS_AVX2)
+
+__attribute__((target("avx2")))
+static void lhc_run_avx2(const float *coefs, float *state, int stride, float *const *io,
+                         int channels, int count, float dn) {
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 flip = _mm256_set1_ps(-1.0f);
+    int ch = 0;
+    for (; ch + 8 <= channels; ch += 8) {
+        const float *k = coefs + ch;
+        const __m256 c3 = _mm256_loadu_ps(k + LHC_C3 * stride), c4 = _mm256_loadu_ps(k + LHC_C4 * stride);
+        const __m256 c6 = _mm256_loadu_ps(k + LHC_C6 * stride), c7 = _mm256_loadu_ps(k + LHC_C7 * stride);
+        const __m256 c8 = _mm256_loadu_ps(k + LHC_C8 * stride), c9 = _mm256_loadu_ps(k + LHC_C9 * stride);
+        const __m256 c10 = _mm256_loadu_ps(k + LHC_C10 * stride);
+        float *s = state + ch;
+        __m256 xp = _mm256_loadu_ps(s + LHC_X * stride);
+        __m256 hp1 = _mm256_loadu_ps(s + LHC_HP1 * stride);
+        __m256 hp2 = _mm256_loadu_ps(s + LHC_HP2 * stride);
+        __m256 a1 = _mm256_loadu_ps(s + LHC_LP1A * stride);
+        __m256 b1 = _mm256_loadu_ps(s + LHC_LP1B * stride);
+        __m256 a2 = _mm256_loadu_ps(s + LHC_LP2A * stride);
+        __m256 b2 = _mm256_loadu_ps(s + LHC_LP2B * stride);
+        __m256 d = _mm256_set1_ps(dn);
+        float *const *x = io + ch;
+        for (int i = 0; i < count; i++) {
+            const __m256 in = _mm256_add_ps(_mm256_setr_ps(x[0][i], x[1][i], x[2][i], x[3][i],
+                                                           x[4][i], x[5][i], x[6][i], x[7][i]), d);
+            d = _mm256_mul_ps(d, flip);
+            const __m256 h1 = _mm256_mul_ps(c6, _mm256_add_ps(_mm256_sub_ps(in, xp), _mm256_mul_ps(c7, hp1)));
+            const __m256 h2 = _mm256_mul_ps(c6, _mm256_add_ps(_mm256_sub_ps(h1, hp1), _mm256_mul_ps(c7, hp2)));
+            const __m256 r1 = _mm256_sub_ps(h2, _mm256_mul_ps(c4, _mm256_add_ps(_mm256_mul_ps(c8, b1), _mm256_mul_ps(c9, a1))));
+            const __m256 y1 = _mm256_mul_ps(c4, _mm256_add_ps(_mm256_add_ps(b1, r1), _mm256_mul_ps(two, a1)));
+            const __m256 r0 = _mm256_sub_ps(y1, _mm256_mul_ps(c3, _mm256_add_ps(_mm256_mul_ps(c10, b2), _mm256_mul_ps(c9, a2))));
+            const __m256 y = _mm256_mul_ps(c3, _mm256_add_ps(_mm256_add_ps(b2, r0), _mm256_mul_ps(two, a2)));
+            float t[8];
+            _mm256_storeu_ps(t, y);
+            for (int l = 0; l < 8; l++) {
+                x[l][i] = t[l];
+            }
+            xp = in;
+            hp1 = h1;
+            hp2 = h2;
+            b1 = a1;
+            a1 = r1;
+            b2 = a2;
+            a2 = r0;
+        }
+        _mm256_storeu_ps(s + LHC_X * stride, xp);
+        _mm256_storeu_ps(s + LHC_HP1 * stride, hp1);
+        _mm256_storeu_ps(s + LHC_HP2 * stride, hp2);
+        _mm256_storeu_ps(s + LHC_LP1A * stride, a1);
+        _mm256_storeu_ps(s + LHC_LP1B * stride, b1);
+        _mm256_storeu_ps(s + LHC_LP2A * stride, a2);
+        _mm256_storeu_ps(s + LHC_LP2B * stride, b2);
+    }
+#if defined(__SSE2__)
+    lhc_run_sse2(coefs + ch, state + ch, stride, io + ch, channels - ch, count, dn);
+#else
+    lhc_run_ref(coefs + ch, state + ch, stride, io + ch, channels - ch, count, dn);
+#endif
+}
+
+#endif  // PITCH_KERNELS_AVX2
+
+/* ------------- kernel selection ------------- */
+
+static const LhcBankKernels lhc_bank_ref = { "scalar", lhc_run_ref };
+#if defined(__SSE2__)
+static const LhcBankKernels lhc_bank_sse2 = { "SSE2", lhc_run_sse2 };
+#endif
+#if defined(PITCH_KERNELS_AVX2)
+static const LhcBankKernels lhc_bank_avx2 = { "AVX2", lhc_run_avx2 };
+#endif
+
+static const LhcBankKernels *lhc_bank_select() {
+#if defined(PITCH_KERNELS_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &lhc_bank_avx2;
+    }
+#endif
+#if defined(__SSE2__)
+    return &lhc_bank_sse2;
+#else
+    return &lhc_bank_ref;
+#endif
+}
+
+
+/* ------------- design ------------- */
+
+// corners of low_high_cut::Dsp in Hz
+static const float LHC_LOW_CUT = 11.5f;
+static const float LHC_HIGH_CUT = 999.0f;
+
+// the design of low_high_cut::Dsp::init() with free corners: two
+// first order highpasses at lowCut and a fourth order butterworth
+// lowpass at highCut, which is kept below nyquist
+inline void lhc_design(LhcCoefs *c, float lowCut, float highCut, unsigned int sampleRate) {
+    const double fs = std::min<double>(192000.0, std::max<double>(1.0, sampleRate));
+    const double c1 = tan(M_PI * std::min<double>(highCut, 0.45 * fs) / fs);
+    const double c2 = 1.0 / c1;
+    const double c5 = 2.0 * M_PI * lowCut / fs;
+    c->c3 = 1.0 / (((c2 + 0.76536686473017945) / c1) + 1.0);
+    c->c4 = 1.0 / (((c2 + 1.8477590650225735) / c1) + 1.0);
+    c->c6 = 1.0 / (c5 + 1.0);
+    c->c7 = 1.0 - c5;
+    c->c8 = ((c2 - 1.8477590650225735) / c1) + 1.0;
+    c->c9 = 2.0 * (1.0 - 1.0 / (c1 * c1));
+    c->c10 = ((c2 - 0.76536686473017945) / c1) + 1.0;
+}
+
+
+/* ------------- LowHighCutBank ------------- */
+
+class LowHighCutBank {
+ public:
+    enum { MAX_CHANNELS = 16 };
+
+    explicit LowHighCutBank(const LhcBankKernels *k = lhc_bank_select())
+        : m_kernels(k), m_channels(0), m_antiDenormal(LHC_ANTI_DENORMAL) {
+        memset(m_coefs, 0, sizeof(m_coefs));
+        clear_state();
+    }
+
+    // the corners of low_high_cut::Dsp on all channels
+    void init(unsigned int sampleRate, int channels) {
+        m_channels = channels < MAX_CHANNELS ? channels : MAX_CHANNELS;
+        LhcCoefs c;
+        lhc_design(&c, LHC_LOW_CUT, LHC_HIGH_CUT, sampleRate);
+        for (int ch = 0; ch < MAX_CHANNELS; ch++) {
+            set_coefs(ch, c);
+        }
+        clear_state();
+    }
+    // new corners for channel ch, the state is kept, so this doesn't click
+    void set_coefs(int ch, const LhcCoefs& c) {
+        float *k = m_coefs + ch;
+        k[LHC_C3 * MAX_CHANNELS] = c.c3;
+        k[LHC_C4 * MAX_CHANNELS] = c.c4;
+        k[LHC_C6 * MAX_CHANNELS] = c.c6;
+        k[LHC_C7 * MAX_CHANNELS] = c.c7;
+        k[LHC_C8 * MAX_CHANNELS] = c.c8;
+        k[LHC_C9 * MAX_CHANNELS] = c.c9;
+        k[LHC_C10 * MAX_CHANNELS] = c.c10;
+    }
+    LhcCoefs coefs(int ch) const {
+        const float *k = m_coefs + ch;
+        LhcCoefs c = { k[LHC_C3 * MAX_CHANNELS], k[LHC_C4 * MAX_CHANNELS],
+                       k[LHC_C6 * MAX_CHANNELS], k[LHC_C7 * MAX_CHANNELS],
+                       k[LHC_C8 * MAX_CHANNELS], k[LHC_C9 * MAX_CHANNELS],
+                       k[LHC_C10 * MAX_CHANNELS] };
+        return c;
+    }
+    int channels() const { return m_channels; }
+    const char *name() const { return m_kernels->name; }
+    // the anti-denormal signal is only left out when the calling
+    // thread flushes denormals to zero
+    void set_flushed(bool v) { m_antiDenormal = v ? 0.0f : LHC_ANTI_DENORMAL; }
+
+    void clear_state() {
+        memset(m_state, 0, sizeof(m_state));
+    }
+
+    // filter count samples of each channel in place
+    void compute(int count, float *const *io) {
+        m_kernels->run(m_coefs, m_state, MAX_CHANNELS, io, m_channels, count, m_antiDenormal);
+    }
+
+ private:
+    const LhcBankKernels *m_kernels;
+    int             m_channels;
+    float           m_antiDenormal;
+    float           m_coefs[LHC_COEF_ROWS * MAX_CHANNELS];
+    float           m_state[LHC_ROWS * MAX_CHANNELS];
+};
+
+
+#endif  // SRC_HEADERS_LHC_BANK_H_
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ * Copyright (C) 2009, 2010 Hermann Meyer, James Warden, Andreas Degert
+ * Copyright (C) 2011 Pete Shorthose
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** pitch estimators
+ **
+ ** the methods which turn one analysis window into a frequency.
+ ** Each one is a class with a static estimate(), the tracker takes
+ ** it as template parameter, so nothing is dispatched inside of it.
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_PITCH_ESTIMATORS_H_
+#define SRC_HEADERS_PITCH_ESTIMATORS_H_
+
+#include <cstring>
+#include <algorithm>
+#include "pitch_kernels.h"
+#include "fft_plans.h"
+
+
+// what an estimator may use, the scratch buffers hold at least
+// plans->size floats, plans are made for a window of n samples
+// zero padded to n + (n+1)/2. The estimator leaves the confidence
+// in its result (0..1) in clarity.
+struct EstimatorContext {
+    const PitchKernels              *kernels;
+    const FftPlanRegistry::Plans    *plans;
+    float                           *time;
+    float                           *freq;
+    int                             sampleRate;
+    float                           clarity;
+};
+
+inline void parabolaTurningPoint(float y_1, float y0, float y1, float xOffset, float *x) {
+    float yTop = y_1 - y1;
+    float yBottom = y1 + y_1 - 2 * y0;
+    if (yBottom != 0.0) {
+        *x = xOffset + yTop / (2 * yBottom);
+    } else {
+        *x = xOffset;
+    }
+}
+
+static int findsubMaximum(const PitchKernels *k, float *input, int len, float threshold) {
+    int indices[10];
+    int length = 0;
+    int overallMaxIndex = findMaxima(k, input, len, indices, &length, 10);
+    if (length == 0) {
+        return -1;
+    }
+    threshold += (1.0 - threshold) * (1.0 - input[overallMaxIndex]);
+    float cutoff = input[overallMaxIndex] * threshold;
+    for (int j = 0; j < length; j++) {
+        if (input[indices[j]] >= cutoff) {
+            return indices[j];
+        }
+    }
+    // should never get here
+    return -1;
+}
+
+// autocorrelation of the n samples at input from the zero padded
+// FFT pair, c.time[k] holds the lag k+1. Returns twice the energy.
+static double fft_acf(const EstimatorContext& c, const float *input, int n) {
+    const int fftSize = c.plans->size;
+    memcpy(c.time, input, n * sizeof(*c.time));
+    memset(c.time+n, 0, (fftSize - n) * sizeof(*c.time));
+    fftwf_execute_r2r(c.plans->fft, c.time, c.freq);
+    c.kernels->fold_power(c.freq, fftSize);
+
+    fftwf_execute_r2r(c.plans->ifft, c.freq, c.time);
+
+    double sumSq = 2.0 * static_cast<double>(c.time[0]) / static_cast<double>(fftSize);
+    c.kernels->shift_scale(c.time, fftSize - n, 1.0f / fftSize);
+    return sumSq;
+}
+
+// frequency of the first NSDF peak within thres of the highest one,
+// nsdf[k] holds the lag k+1. 0 when there is none. The peak height
+// is stored in clarity.
+static float nsdf_pitch(const PitchKernels *k, float *nsdf, int count, int sampleRate,
+                        float thres, float *clarity) {
+    int maxAutocorrIndex = findsubMaximum(k, nsdf, count, thres);
+
+    float x = 0.0;
+    *clarity = 0.0;
+    if (maxAutocorrIndex >= 0) {
+        *clarity = nsdf[maxAutocorrIndex];
+        parabolaTurningPoint(nsdf[maxAutocorrIndex-1],
+                             nsdf[maxAutocorrIndex],
+                             nsdf[maxAutocorrIndex+1],
+                             maxAutocorrIndex+1, &x);
+        x = sampleRate / x;
+    }
+    return x;
+}
+
+
+/* ------------- McLeod pitch method ------------- */
+
+// normalized square difference function (tartini)
+struct McLeodEstimator {
+    static const char *name() { return "MPM"; }
+    // works on a few periods of the pitch
+    static bool adaptive() { return true; }
+    static float estimate(EstimatorContext& c, const float *input, int n,
+                          float thres = 0.99) { // was 0.6
+        double sumSq = fft_acf(c, input, n);
+        int count = (n + 1) / 2;
+        c.kernels->normalize(c.time, input, n, count, sumSq);
+        return nsdf_pitch(c.kernels, c.time, count, c.sampleRate, thres, &c.clarity);
+    }
+};
+
+
+/* ------------- YIN ------------- */
+
+// cumulative mean normalized difference (de Cheveigné, Kawahara),
+// the difference function comes from the same autocorrelation
+struct YinEstimator {
+    static const char *name() { return "YIN"; }
+    static bool adaptive() { return true; }
+    static float estimate(EstimatorContext& c, const float *input, int n) {
+        const float thres = 0.15;
+        double sumSq = fft_acf(c, input, n);
+        const int count = (n + 1) / 2;
+        float *d = c.time;
+        double sum = 0.0;
+        for (int k = 0; k < count; k++) {
+            sumSq -= sq(input[n-1-k]) + sq(input[k]);
+            double dk = sumSq - 2.0 * d[k];
+            sum += dk;
+            d[k] = sum > 0.0 ? dk * (k + 1) / sum : 1.0;
+        }
+        // first dip below the threshold, followed down to its minimum
+        int k = 1;
+        while (k < count - 1 && d[k] >= thres) {
+            k++;
+        }
+        c.clarity = 0.0;
+        if (k >= count - 1) {
+            return 0.0;
+        }
+        while (k < count - 2 && d[k+1] < d[k]) {
+            k++;
+        }
+        c.clarity = 1.0 - d[k];
+        float x;
+        parabolaTurningPoint(d[k-1], d[k], d[k+1], k+1, &x);
+        return c.sampleRate / x;
+    }
+};
+
+
+/* ------------- harmonic product spectrum ------------- */
+
+// the fundamental is the bin where the spectrum and its compressed
+// copies line up, refined on the strongest of the harmonics
+struct HpsEstimator {
+    static const char *name() { return "HPS"; }
+    // the bin width depends on the window size only
+    static bool adaptive() { return false; }
+    static float estimate(EstimatorContext& c, const float *input, int n) {
+        const int harmonics = 4;
+        const float minFreq = 40.0;
+        const int fftSize = c.plans->size;
+        for (int j = 0; j < n; j++) {
+            c.time[j] = input[j] * (0.5f - 0.5f * cosf(2.0f * M_PI * j / (n - 1)));
+        }
+        memset(c.time+n, 0, (fftSize - n) * sizeof(*c.time));
+        fftwf_execute_r2r(c.plans->fft, c.time, c.freq);
+        c.kernels->fold_power(c.freq, fftSize);
+        const float *p = c.freq;
+        const float eps = 1e-12;
+
+        const int kmin = std::max(2, static_cast<int>(minFreq * fftSize / c.sampleRate));
+        const int kmax = fftSize / 2 / harmonics;
+        int best = 0;
+        float bestScore = 0.0;
+        for (int k = kmin; k < kmax; k++) {
+            float score = 0.0;
+            for (int h = 1; h <= harmonics; h++) {
+                score += logf(p[h*k] + eps);
+            }
+            if (!best || score > bestScore) {
+                best = k;
+                bestScore = score;
+            }
+        }
+        c.clarity = 0.0;
+        if (!best) {
+            return 0.0;
+        }
+        // a stronger subharmonic means the product caught an overtone
+        int half = (best + 1) / 2;
+        if (half >= kmin && p[half] > 0.1f * p[best]) {
+            best = half;
+        }
+        int h = 1;
+        for (int j = 2; j <= harmonics; j++) {
+            if (p[j*best] > p[h*best]) {
+                h = j;
+            }
+        }
+        const int b = h * best;
+        // share of the harmonics in the power of their region
+        float sum = 0.0, peaks = 0.0;
+        for (int k = best / 2; k < std::min(harmonics * best + best / 2, fftSize / 2); k++) {
+            sum += p[k];
+        }
+        for (int j = 1; j <= harmonics; j++) {
+            peaks += p[j*best-1] + p[j*best] + p[j*best+1];
+        }
+        c.clarity = sum > 0.0 ? std::min(1.0f, peaks / sum) : 0.0f;
+        float x;
+        parabolaTurningPoint(logf(p[b-1] + eps), logf(p[b] + eps), logf(p[b+1] + eps), b, &x);
+        return x * c.sampleRate / (h * fftSize);
+    }
+};
+
+
+#endif  // SRC_HEADERS_PITCH_ESTIMATORS_H_
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** pitch filter
+ **
+ ** Kalman filter over the pitch in octaves (log2 Hz) and its drift
+ ** in octaves per second. The measurement noise follows the clarity
+ ** of each estimate, estimates with too little clarity only advance
+ ** the prediction, and a jump of more than a semitone starts over.
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_PITCH_FILTER_H_
+#define SRC_HEADERS_PITCH_FILTER_H_
+
+#include <math.h>
+#include <atomic>
+#include "pitch_kernels.h"
+
+
+// innovation statistics of the filter
+struct FilterStats {
+    unsigned long   updates;    // estimates taken in
+    unsigned long   gated;      // estimates dropped for low clarity
+    unsigned long   resets;     // note changes
+    float           nis;        // mean normalized innovation squared, ~1 when tuned well
+    float           rms_cents;  // rms innovation
+};
+
+
+/* ------------- PitchFilter ------------- */
+
+class PitchFilter {
+ public:
+    PitchFilter() { reset(); }
+
+    void reset() {
+        m_valid = false;
+        m_updates.store(0, std::memory_order_relaxed);
+        m_gated.store(0, std::memory_order_relaxed);
+        m_resets.store(0, std::memory_order_relaxed);
+        m_nisSum.store(0.0, std::memory_order_relaxed);
+        m_innoSum.store(0.0, std::memory_order_relaxed);
+    }
+    // silence, the next estimate starts over
+    void clear() { m_valid = false; }
+
+    // feed the estimate freq, dt seconds after the previous one.
+    // Returns the filtered pitch, 0 while there is none.
+    float update(float freq, float clarity, float dt) {
+        if (freq <= 0.0) {
+            m_valid = false;
+            return 0.0;
+        }
+        if (m_valid) {
+            predict(dt);
+        }
+        if (clarity < MIN_CLARITY) {
+            bump(m_gated);
+            return m_valid ? exp2f(m_p) : 0.0;
+        }
+        const float z = log2f(freq);
+        // 4 cent at full clarity, growing quickly below
+        const float r = sq(CENT * 4.0f) / sq(clarity * clarity);
+        if (!m_valid || fabsf(z - m_p) > SEMITONE_OCT) {
+            if (m_valid) {
+                bump(m_resets);
+            }
+            m_p = z;
+            m_v = 0.0;
+            m_p00 = r;
+            m_p01 = 0.0;
+            m_p11 = sq(DRIFT_SD);
+            m_valid = true;
+            return freq;
+        }
+        const float y = z - m_p;
+        const float s = m_p00 + r;
+        const float k0 = m_p00 / s;
+        const float k1 = m_p01 / s;
+        m_p += k0 * y;
+        m_v += k1 * y;
+        const float p00 = (1.0f - k0) * m_p00;
+        const float p01 = (1.0f - k0) * m_p01;
+        const float p11 = m_p11 - k1 * m_p01;
+        m_p00 = p00;
+        m_p01 = p01;
+        m_p11 = p11;
+        bump(m_updates);
+        m_nisSum.store(m_nisSum.load(std::memory_order_relaxed) + y * y / s,
+                       std::memory_order_relaxed);
+        m_innoSum.store(m_innoSum.load(std::memory_order_relaxed) + sq(y / CENT),
+                        std::memory_order_relaxed);
+        return exp2f(m_p);
+    }
+
+    // may be called from any thread
+    void get_stats(FilterStats *stats) const {
+        stats->updates = m_updates.load(std::memory_order_relaxed);
+        stats->gated = m_gated.load(std::memory_order_relaxed);
+        stats->resets = m_resets.load(std::memory_order_relaxed);
+        double nis = m_nisSum.load(std::memory_order_relaxed);
+        double inno = m_innoSum.load(std::memory_order_relaxed);
+        stats->nis = stats->updates ? nis / stats->updates : 0.0;
+        stats->rms_cents = stats->updates ? sqrt(inno / stats->updates) : 0.0;
+    }
+
+ private:
+    static constexpr float CENT = 1.0f / 1200.0f;
+    static constexpr float SEMITONE_OCT = 1.0f / 12.0f;
+    static constexpr float MIN_CLARITY = 0.5f;
+    // random walk of the pitch (1 cent/s) and of the drift
+    static constexpr float PITCH_NOISE = CENT;
+    static constexpr float DRIFT_NOISE = 5.0f * CENT;
+    static constexpr float DRIFT_SD = 10.0f * CENT;
+
+    // the counters have a single writer
+    static void bump(std::atomic<unsigned long>& c) {
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void predict(float dt) {
+        m_p += m_v * dt;
+        // P = F P F' + Q with F = [1 dt; 0 1]
+        m_p00 += dt * (2.0f * m_p01 + dt * m_p11) + sq(PITCH_NOISE) * dt;
+        m_p01 += dt * m_p11;
+        m_p11 += sq(DRIFT_NOISE) * dt;
+    }
+
+    bool            m_valid;
+    float           m_p;        // pitch in octaves
+    float           m_v;        // drift in octaves per second
+    float           m_p00, m_p01, m_p11;
+    // statistics, written by the worker only
+    std::atomic<unsigned long> m_updates;
+    std::atomic<unsigned long> m_gated;
+    std::atomic<unsigned long> m_resets;
+    std::atomic<double> m_nisSum;
+    std::atomic<double> m_innoSum;
+};
+
+
+#endif  // SRC_HEADERS_PITCH_FILTER_H_
@@ -0,0 +1,570 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** NSDF kernels
+ **
+ ** the hot loops of the pitch tracker as scalar reference,
+ ** SSE2 and AVX2 versions. The best set for the running CPU
+ ** is picked once by pitch_kernels_select().
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_PITCH_KERNELS_H_
+#define SRC_HEADERS_PITCH_KERNELS_H_
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PITCH_KERNELS_AVX2
+#endif
+
+struct PitchKernels {
+    const char *name;
+    // sum of the absolute values of x
+    float (*sum_abs)(const float *x, int n);
+    // fold a halfcomplex spectrum of size n into its power spectrum
+    void  (*fold_power)(float *buf, int n);
+    // buf[k] = buf[k+1] * scale for k < count
+    void  (*shift_scale)(float *buf, int count, float scale);
+    // divide the autocorrelation by the running energy term of the NSDF
+    void  (*normalize)(float *nsdf, const float *input, int n, int count, double sumSq);
+    // first index in [pos, end) with x <= 0, or end
+    int   (*find_le)(const float *x, int pos, int end);
+    // first index in [pos, end) with x > 0, or end
+    int   (*find_gt)(const float *x, int pos, int end);
+    // first index of the maximum in [pos, end)
+    int   (*argmax)(const float *x, int pos, int end);
+    // acc[k] += a * x[k] - b * y[k], the running autocorrelation step
+    void  (*acf_update)(double *acc, const float *x, const float *y, float a, float b, int n);
+    // sum of x[k] * y[k]
+    float (*dot)(const float *x, const float *y, int n);
+};
+
+inline float sq(float x) {
+    return x * x;
+}
+
+/* ------------- scalar reference ------------- */
+
+static float sum_abs_ref(const float *x, int n) {
+    float sum = 0.0;
+    for (int k = 0; k < n; ++k) {
+        sum += fabs(x[k]);
+    }
+    return sum;
+}
+
+static void fold_power_ref(float *buf, int n) {
+    for (int k = 1; k < n/2; k++) {
+        buf[k] = sq(buf[k]) + sq(buf[n-k]);
+        buf[n-k] = 0.0;
+    }
+    buf[0] = sq(buf[0]);
+    buf[n/2] = sq(buf[n/2]);
+}
+
+static void shift_scale_ref(float *buf, int count, float scale) {
+    for (int k = 0; k < count; k++) {
+        buf[k] = buf[k+1] * scale;
+    }
+}
+
+static void normalize_ref(float *nsdf, const float *input, int n, int count, double sumSq) {
+    for (int k = 0; k < count; k++) {
+        sumSq  -= sq(input[n-1-k]) + sq(input[k]);
+        // dividing by zero is very slow, so deal with it seperately
+        if (sumSq > 0.0) {
+            nsdf[k] *= 2.0 / sumSq;
+        } else {
+            nsdf[k] = 0.0;
+        }
+    }
+}
+
+static int find_le_ref(const float *x, int pos, int end) {
+    while (pos < end && x[pos] > 0.0) {
+        pos += 1;
+    }
+    return pos;
+}
+
+static int find_gt_ref(const float *x, int pos, int end) {
+    while (pos < end && x[pos] <= 0.0) {
+        pos += 1;
+    }
+    return pos;
+}
+
+static int argmax_ref(const float *x, int pos, int end) {
+    int m = pos;
+    for (int k = pos + 1; k < end; k++) {
+        if (x[k] > x[m]) {
+            m = k;
+        }
+    }
+    return m;
+}
+
+static void acf_update_ref(double *acc, const float *x, const float *y, float a, float b, int n) {
+    for (int k = 0; k < n; k++) {
+        acc[k] += static_cast<double>(a) * x[k] - static_cast<double>(b) * y[k];
+    }
+}
+
+static float dot_ref(const float *x, const float *y, int n) {
+    float sum = 0.0;
+    for (int k = 0; k < n; k++) {
+        sum += x[k] * y[k];
+    }
+    return sum;
+}
+
+/* ------------- SSE2 ------------- */
+
+#if defined(__SSE2__)
+
+static float sum_abs_sse2(const float *x, int n) {
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_and_ps(_mm_loadu_ps(x + k), mask));
+        acc1 = _mm_add_ps(acc1, _mm_and_ps(_mm_loadu_ps(x + k + 4), mask));
+    }
+    float t[4];
+    _mm_storeu_ps(t, _mm_add_ps(acc0, acc1));
+    float sum = (t[0] + t[1]) + (t[2] + t[3]);
+    for (; k < n; k++) {
+        sum += fabs(x[k]);
+    }
+    return sum;
+}
+
+static void fold_power_sse2(float *buf, int n) {
+    const int h = n/2;
+    const __m128 zero = _mm_setzero_ps();
+    int k = 1;
+    // buf[k..k+3] and buf[n-k-3..n-k] never overlap while k+3 < h
+    for (; k + 3 < h; k += 4) {
+        __m128 re = _mm_loadu_ps(buf + k);
+        __m128 im = _mm_loadu_ps(buf + n - k - 3);
+        im = _mm_shuffle_ps(im, im, _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_ps(buf + k, _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im)));
+        _mm_storeu_ps(buf + n - k - 3, zero);
+    }
+    for (; k < h; k++) {
+        buf[k] = sq(buf[k]) + sq(buf[n-k]);
+        buf[n-k] = 0.0;
+    }
+    buf[0] = sq(buf[0]);
+    buf[h] = sq(buf[h]);
+}
+
+static void shift_scale_sse2(float *buf, int count, float scale) {
+    const __m128 s = _mm_set1_ps(scale);
+    int k = 0;
+    // the load runs ahead of the store, so the in place shift is safe
+    for (; k + 4 <= count; k += 4) {
+        _mm_storeu_ps(buf + k, _mm_mul_ps(_mm_loadu_ps(buf + k + 1), s));
+    }
+    for (; k < count; k++) {
+        buf[k] = buf[k+1] * scale;
+    }
+}
+
+// sumSq decreases by the prefix sum of t[k] = input[n-1-k]^2 + input[k]^2,
+// which is built two lanes at a time and carried over in double
+static void normalize_sse2(float *nsdf, const float *input, int n, int count, double sumSq) {
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d two = _mm_set1_pd(2.0);
+    __m128d carry = _mm_set1_pd(sumSq);
+    int k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m128 lo = _mm_loadu_ps(input + k);
+        __m128 hi = _mm_loadu_ps(input + n - 4 - k);
+        hi = _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(0, 1, 2, 3));
+        __m128 t = _mm_add_ps(_mm_mul_ps(hi, hi), _mm_mul_ps(lo, lo));
+        __m128 v = _mm_loadu_ps(nsdf + k);
+        __m128d r[2];
+        for (int j = 0; j < 2; j++) {
+            __m128d td = _mm_cvtps_pd(t);
+            td = _mm_add_pd(td, _mm_unpacklo_pd(zero, td));
+            __m128d s = _mm_sub_pd(carry, td);
+            carry = _mm_unpackhi_pd(s, s);
+            __m128d f = _mm_and_pd(_mm_div_pd(two, s), _mm_cmpgt_pd(s, zero));
+            r[j] = _mm_mul_pd(_mm_cvtps_pd(v), f);
+            t = _mm_movehl_ps(t, t);
+            v = _mm_movehl_ps(v, v);
+        }
+        _mm_storeu_ps(nsdf + k, _mm_movelh_ps(_mm_cvtpd_ps(r[0]), _mm_cvtpd_ps(r[1])));
+    }
+    _mm_store_sd(&sumSq, carry);
+    normalize_ref(nsdf + k, input + k, n - 2 * k, count - k, sumSq);
+}
+
+static int find_le_sse2(const float *x, int pos, int end) {
+    const __m128 zero = _mm_setzero_ps();
+    for (; pos + 4 <= end; pos += 4) {
+        int m = _mm_movemask_ps(_mm_cmpngt_ps(_mm_loadu_ps(x + pos), zero));
+        if (m) {
+            return pos + __builtin_ctz(m);
+        }
+    }
+    return find_le_ref(x, pos, end);
+}
+
+static int find_gt_sse2(const float *x, int pos, int end) {
+    const __m128 zero = _mm_setzero_ps();
+    for (; pos + 4 <= end; pos += 4) {
+        int m = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(x + pos), zero));
+        if (m) {
+            return pos + __builtin_ctz(m);
+        }
+    }
+    return find_gt_ref(x, pos, end);
+}
+
+static int argmax_sse2(const float *x, int pos, int end) {
+    if (end - pos < 8) {
+        return argmax_ref(x, pos, end);
+    }
+    // find the maximum first, then its first position
+    __m128 vmax = _mm_loadu_ps(x + pos);
+    int k = pos + 4;
+    for (; k + 4 <= end; k += 4) {
+        vmax = _mm_max_ps(vmax, _mm_loadu_ps(x + k));
+    }
+    float t[4];
+    _mm_storeu_ps(t, vmax);
+    float m = t[0];
+    for (int j = 1; j < 4; j++) {
+        m = t[j] > m ? t[j] : m;
+    }
+    for (; k < end; k++) {
+        m = x[k] > m ? x[k] : m;
+    }
+    const __m128 vm = _mm_set1_ps(m);
+    for (k = pos; k + 4 <= end; k += 4) {
+        int e = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(x + k), vm));
+        if (e) {
+            return k + __builtin_ctz(e);
+        }
+    }
+    for (; k < end; k++) {
+        if (x[k] == m) {
+            return k;
+        }
+    }
+    return pos;
+}
+
+static void acf_update_sse2(double *acc, const float *x, const float *y, float a, float b, int n) {
+    const __m128d va = _mm_set1_pd(a);
+    const __m128d vb = _mm_set1_pd(b);
+    int k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m128 xs = _mm_loadu_ps(x + k);
+        __m128 ys = _mm_loadu_ps(y + k);
+        __m128d lo = _mm_sub_pd(_mm_mul_pd(va, _mm_cvtps_pd(xs)), _mm_mul_pd(vb, _mm_cvtps_pd(ys)));
+        __m128d hi = _mm_sub_pd(_mm_mul_pd(va, _mm_cvtps_pd(_mm_movehl_ps(xs, xs))),
+                                _mm_mul_pd(vb, _mm_cvtps_pd(_mm_movehl_ps(ys, ys))));
+        _mm_storeu_pd(acc + k, _mm_add_pd(_mm_loadu_pd(acc + k), lo));
+        _mm_storeu_pd(acc + k + 2, _mm_add_pd(_mm_loadu_pd(acc + k + 2), hi));
+    }
+    acf_update_ref(acc + k, x + k, y + k, a, b, n - k);
+}
+
+static float dot_sse2(const float *x, const float *y, int n) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(y + k)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + k + 4), _mm_loadu_ps(y + k + 4)));
+    }
+    float t[4];
+    _mm_storeu_ps(t, _mm_add_ps(acc0, acc1));
+    return (t[0] + t[1]) + (t[2] + t[3]) + dot_ref(x + k, y + k, n - k);
+}
+
+#endif  // __SSE2__
+
+/* ------------- AVX2 ------------- */
+
+#if defined(PITCH_KERNELS_AVX2)
+
+__attribute__((target("avx2")))
+static float sum_abs_avx2(const float *x, int n) {
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int k = 0;
+    for (; k + 16 <= n; k += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_and_ps(_mm256_loadu_ps(x + k), mask));
+        acc1 = _mm256_add_ps(acc1, _mm256_and_ps(_mm256_loadu_ps(x + k + 8), mask));
+    }
+    float t[8];
+    _mm256_storeu_ps(t, _mm256_add_ps(acc0, acc1));
+    float sum = ((t[0] + t[1]) + (t[2] + t[3])) + ((t[4] + t[5]) + (t[6] + t[7]));
+    for (; k < n; k++) {
+        sum += fabs(x[k]);
+    }
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static void fold_power_avx2(float *buf, int n) {
+    const int h = n/2;
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i rev = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int k = 1;
+    for (; k + 7 < h; k += 8) {
+        __m256 re = _mm256_loadu_ps(buf + k);
+        __m256 im = _mm256_permutevar8x32_ps(_mm256_loadu_ps(buf + n - k - 7), rev);
+        _mm256_storeu_ps(buf + k, _mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im)));
+        _mm256_storeu_ps(buf + n - k - 7, zero);
+    }
+    for (; k < h; k++) {
+        buf[k] = sq(buf[k]) + sq(buf[n-k]);
+        buf[n-k] = 0.0;
+    }
+    buf[0] = sq(buf[0]);
+    buf[h] = sq(buf[h]);
+}
+
+__attribute__((target("avx2")))
+static void shift_scale_avx2(float *buf, int count, float scale) {
+    const __m256 s = _mm256_set1_ps(scale);
+    int k = 0;
+    for (; k + 8 <= count; k += 8) {
+        _mm256_storeu_ps(buf + k, _mm256_mul_ps(_mm256_loadu_ps(buf + k + 1), s));
+    }
+    for (; k < count; k++) {
+        buf[k] = buf[k+1] * scale;
+    }
+}
+
+__attribute__((target("avx2")))
+static void normalize_avx2(float *nsdf, const float *input, int n, int count, double sumSq) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d two = _mm256_set1_pd(2.0);
+    __m256d carry = _mm256_set1_pd(sumSq);
+    int k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m128 lo = _mm_loadu_ps(input + k);
+        __m128 hi = _mm_loadu_ps(input + n - 4 - k);
+        hi = _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(0, 1, 2, 3));
+        __m256d t = _mm256_cvtps_pd(_mm_add_ps(_mm_mul_ps(hi, hi), _mm_mul_ps(lo, lo)));
+        // inclusive prefix sum over the four lanes
+        t = _mm256_add_pd(t, _mm256_blend_pd(_mm256_permute4x64_pd(t, 0x90), zero, 0x1));
+        t = _mm256_add_pd(t, _mm256_blend_pd(_mm256_permute4x64_pd(t, 0x40), zero, 0x3));
+        __m256d s = _mm256_sub_pd(carry, t);
+        carry = _mm256_permute4x64_pd(s, 0xff);
+        __m256d f = _mm256_and_pd(_mm256_div_pd(two, s), _mm256_cmp_pd(s, zero, _CMP_GT_OQ));
+        __m256d r = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(nsdf + k)), f);
+        _mm_storeu_ps(nsdf + k, _mm256_cvtpd_ps(r));
+    }
+    sumSq = _mm_cvtsd_f64(_mm256_castpd256_pd128(carry));
+    normalize_ref(nsdf + k, input + k, n - 2 * k, count - k, sumSq);
+}
+
+__attribute__((target("avx2")))
+static int find_le_avx2(const float *x, int pos, int end) {
+    const __m256 zero = _mm256_setzero_ps();
+    for (; pos + 8 <= end; pos += 8) {
+        int m = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(x + pos), zero, _CMP_NGT_UQ));
+        if (m) {
+            return pos + __builtin_ctz(m);
+        }
+    }
+    return find_le_ref(x, pos, end);
+}
+
+__attribute__((target("avx2")))
+static int find_gt_avx2(const float *x, int pos, int end) {
+    const __m256 zero = _mm256_setzero_ps();
+    for (; pos + 8 <= end; pos += 8) {
+        int m = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(x + pos), zero, _CMP_GT_OQ));
+        if (m) {
+            return pos + __builtin_ctz(m);
+        }
+    }
+    return find_gt_ref(x, pos, end);
+}
+
+__attribute__((target("avx2")))
+static int argmax_avx2(const float *x, int pos, int end) {
+    if (end - pos < 16) {
+        return argmax_ref(x, pos, end);
+    }
+    __m256 vmax = _mm256_loadu_ps(x + pos);
+    int k = pos + 8;
+    for (; k + 8 <= end; k += 8) {
+        vmax = _mm256_max_ps(vmax, _mm256_loadu_ps(x + k));
+    }
+    float t[8];
+    _mm256_storeu_ps(t, vmax);
+    float m = t[0];
+    for (int j = 1; j < 8; j++) {
+        m = t[j] > m ? t[j] : m;
+    }
+    for (; k < end; k++) {
+        m = x[k] > m ? x[k] : m;
+    }
+    const __m256 vm = _mm256_set1_ps(m);
+    for (k = pos; k + 8 <= end; k += 8) {
+        int e = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(x + k), vm, _CMP_EQ_OQ));
+        if (e) {
+            return k + __builtin_ctz(e);
+        }
+    }
+    for (; k < end; k++) {
+        if (x[k] == m) {
+            return k;
+        }
+    }
+    return pos;
+}
+
+__attribute__((target("avx2")))
+static void acf_update_avx2(double *acc, const float *x, const float *y, float a, float b, int n) {
+    const __m256d va = _mm256_set1_pd(a);
+    const __m256d vb = _mm256_set1_pd(b);
+    int k = 0;
+    for (; k + 8 <= n; k += 8) {
+        for (int j = 0; j < 8; j += 4) {
+            __m256d xd = _mm256_cvtps_pd(_mm_loadu_ps(x + k + j));
+            __m256d yd = _mm256_cvtps_pd(_mm_loadu_ps(y + k + j));
+            __m256d d = _mm256_sub_pd(_mm256_mul_pd(va, xd), _mm256_mul_pd(vb, yd));
+            _mm256_storeu_pd(acc + k + j, _mm256_add_pd(_mm256_loadu_pd(acc + k + j), d));
+        }
+    }
+    acf_update_ref(acc + k, x + k, y + k, a, b, n - k);
+}
+
+__attribute__((target("avx2")))
+static float dot_avx2(const float *x, const float *y, int n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int k = 0;
+    for (; k + 16 <= n; k += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(x + k), _mm256_loadu_ps(y + k)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(x + k + 8), _mm256_loadu_ps(y + k + 8)));
+    }
+    float t[8];
+    _mm256_storeu_ps(t, _mm256_add_ps(acc0, acc1));
+    return ((t[0] + t[1]) + (t[2] + t[3])) + ((t[4] + t[5]) + (t[6] + t[7])) +
+           dot_ref(x + k, y + k, n - k);
+}
+
+#endif  // PITCH_KERNELS_AVX2
+
+/* ------------- kernel selection ------------- */
+
+static const PitchKernels pitch_kernels_ref = {
+    "scalar", sum_abs_ref, fold_power_ref, shift_scale_ref,
+    normalize_ref, find_le_ref, find_gt_ref, argmax_ref, acf_update_ref,
+    dot_ref
+};
+
+#if defined(__SSE2__)
+static const PitchKernels pitch_kernels_sse2 = {
+    "SSE2", sum_abs_sse2, fold_power_sse2, shift_scale_sse2,
+    normalize_sse2, find_le_sse2, find_gt_sse2, argmax_sse2, acf_update_sse2,
+    dot_sse2
+};
+#endif
+
+#if defined(PITCH_KERNELS_AVX2)
+static const PitchKernels pitch_kernels_avx2 = {
+    "AVX2", sum_abs_avx2, fold_power_avx2, shift_scale_avx2,
+    normalize_avx2, find_le_avx2, find_gt_avx2, argmax_avx2, acf_update_avx2,
+    dot_avx2
+};
+#endif
+
+static const PitchKernels *pitch_kernels_select() {
+#if defined(PITCH_KERNELS_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &pitch_kernels_avx2;
+    }
+#endif
+#if defined(__SSE2__)
+    return &pitch_kernels_sse2;
+#else
+    return &pitch_kernels_ref;
+#endif
+}
+
+/* ------------- peak picking ------------- */
+
+// same result as the scalar findMaxima() in kernel_test.cpp, but
+// walks the NSDF a positive lobe at a time. Inside a lobe enclosed by
+// two zero crossings the first position of the lobe maximum is always
+// the highest local maximum, so the lobe is searched with the vector
+// kernels. Lobes cut by the search start or the end of the buffer keep
+// the element wise scan.
+static int findMaxima(const PitchKernels *k, const float *input, int len,
+                      int *maxPositions, int *length, int maxLen) {
+    int overallMaxIndex = 0;
+    int pos = k->find_le(input, 0, (len-1)/3);
+    pos = k->find_gt(input, pos, len-1);
+    if (pos == 0) {
+        pos = 1;  // can happen if output[0] is NAN
+    }
+    while (pos < len-1) {
+        int end = k->find_le(input, pos, len-1);
+        int curMaxPos = 0;
+        if (end == len-1 || input[pos-1] > 0.0) {
+            for (int p = pos; p < end; p++) {
+                if (input[p] > input[p-1] && input[p] >= input[p+1]) {
+                    if (curMaxPos == 0 || input[p] > input[curMaxPos]) {
+                        curMaxPos = p;
+                    }
+                }
+            }
+        } else if (end > pos) {
+            curMaxPos = k->argmax(input, pos, end);
+        }
+        if (curMaxPos > 0) {
+            maxPositions[*length] = curMaxPos;
+            *length += 1;
+            if (overallMaxIndex == 0 || input[curMaxPos] > input[overallMaxIndex]) {
+                overallMaxIndex = curMaxPos;
+            }
+            if (*length >= maxLen && end < len-1) {
+                return overallMaxIndex;
+            }
+        }
+        pos = k->find_gt(input, end, len-1);
+    }
+    return overallMaxIndex;
+}
+
+#endif  // SRC_HEADERS_PITCH_KERNELS_H_
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** realtime configuration
+ **
+ ** keys in the config file (and as --key value on the command line):
+ **   [rt_priority]      worker priority relative to jack, default -5
+ **   [rt_policy]        fifo, rr or other
+ **   [cpus]             cores for the workers, e.g. 2,3 or 0-3
+ **   [mlock]            lock all memory, 0 (default) or 1
+ **   [flush_denormals]  FTZ/DAZ in the DSP threads, 0 or 1
+ **   [stack_kb]         worker stack, prefaulted
+ ** With denormals flushed the filter bank needs no noise against them,
+ ** without (flush_denormals 0, or neither SSE nor aarch64) it adds it.
+ ** The jack thread's priority and cores are left to jackd.
+ */
+
+#include <stdio.h>
+#include <sched.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <alloca.h>
+#include <sys/mman.h>
+#include <algorithm>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// the jack thread's stack is jack's, only this much of it is touched
+static const size_t JACK_STACK_PREFAULT = 64 * 1024;
+
+RtConfig& RtConfig::instance() {
+    static RtConfig config;
+    return config;
+}
+
+RtConfig::RtConfig()
+    : m_priorityOffset(-5),
+      m_policy(SCHED_FIFO),
+      m_cpus(),
+      m_mlock(false),
+      m_flushDenormals(true),
+      m_stackKb(256),
+      m_jackPriority(0) {
+}
+
+static const char *policy_name(int policy) {
+    switch (policy) {
+    case SCHED_FIFO: return "fifo";
+    case SCHED_RR: return "rr";
+    default: return "other";
+    }
+}
+
+bool RtConfig::set(const std::string& key, const std::string& value) {
+    char *end;
+    long v = strtol(value.c_str(), &end, 10);
+    bool number = !value.empty() && *end == '\0';
+    if (key == "rt_priority" && number) {
+        m_priorityOffset = v;
+    } else if (key == "rt_policy") {
+        if (value == "fifo") {
+            m_policy = SCHED_FIFO;
+        } else if (value == "rr") {
+            m_policy = SCHED_RR;
+        } else if (value == "other") {
+            m_policy = SCHED_OTHER;
+        } else {
+            return false;
+        }
+    } else if (key == "cpus") {
+        m_cpus = value == "all" ? "" : value;
+    } else if (key == "mlock" && number) {
+        m_mlock = v;
+    } else if (key == "flush_denormals" && number) {
+        m_flushDenormals = v;
+    } else if (key == "stack_kb" && number && v >= 64) {
+        m_stackKb = v;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void RtConfig::save(std::ostream& out) const {
+    out << "[rt_priority] " << m_priorityOffset << std::endl;
+    out << "[rt_policy] " << policy_name(m_policy) << std::endl;
+    out << "[cpus] " << (m_cpus.empty() ? "all" : m_cpus) << std::endl;
+    out << "[mlock] " << m_mlock << std::endl;
+    out << "[flush_denormals] " << m_flushDenormals << std::endl;
+    out << "[stack_kb] " << m_stackKb << std::endl;
+}
+
+void RtConfig::worker_sched(int *policy, int *priority) const {
+    *policy = SCHED_OTHER;
+    *priority = 0;
+#ifdef _POSIX_PRIORITY_SCHEDULING
+    if (m_policy == SCHED_OTHER || m_jackPriority < 0) {
+        return;
+    }
+    const int lo = sched_get_priority_min(m_policy);
+    const int hi = sched_get_priority_max(m_policy);
+    // without word from jack as before, well in the middle
+    int p = m_jackPriority ? m_jackPriority + m_priorityOffset : hi / 2.2;
+    *policy = m_policy;
+    *priority = std::max(lo, std::min(hi, p));
+#endif
+}
+
+int RtConfig::worker_cpus(int *cpus, int max) const {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+        cpus[0] = 0;
+        return 1;
+    }
+    cpu_set_t wanted;
+    CPU_ZERO(&wanted);
+    // a list like 0,2-3
+    const char *p = m_cpus.c_str();
+    while (*p) {
+        char *end;
+        long a = strtol(p, &end, 10);
+        long b = a;
+        if (end == p) {
+            break;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            b = strtol(p, &end, 10);
+        }
+        for (long c = a; c <= b && c < CPU_SETSIZE; c++) {
+            CPU_SET(c, &wanted);
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    if (CPU_COUNT(&wanted)) {
+        CPU_AND(&wanted, &wanted, &allowed);
+        if (!CPU_COUNT(&wanted)) {
+            fprintf(stderr, "cpus %s: none of them available, using all\n", m_cpus.c_str());
+        }
+    }
+    const cpu_set_t& use = CPU_COUNT(&wanted) ? wanted : allowed;
+    int n = 0;
+    for (int c = 0; c < CPU_SETSIZE && n < max; c++) {
+        if (CPU_ISSET(c, &use)) {
+            cpus[n++] = c;
+        }
+    }
+    if (!n) {
+        cpus[n++] = 0;
+    }
+    return n;
+}
+
+void RtConfig::lock_memory() {
+    if (!m_mlock) {
+        return;
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        fprintf(stderr, "mlockall failed: %s, memory may be paged out\n", strerror(errno));
+        return;
+    }
+    fprintf(stderr, "memory locked\n");
+}
+
+__attribute__((noinline))
+static void prefault_stack(size_t n) {
+    volatile char *p = static_cast<volatile char*>(alloca(n));
+    for (size_t i = 0; i < n; i += 4096) {
+        p[i] = 0;
+    }
+}
+
+void RtConfig::setup_dsp_thread(size_t stack) {
+    if (m_flushDenormals) {
+#if defined(__SSE__)
+        // FTZ, and DAZ (0x0040) which any SSE2 cpu has
+        _mm_setcsr(_mm_getcsr() | _MM_FLUSH_ZERO_ON | 0x0040);
+#elif defined(__aarch64__)
+        unsigned long fpcr;
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1UL << 24)));
+#endif
+    }
+    // no page faults on first use, locked or not, leave room for the
+    // frames above us
+    prefault_stack(stack ? stack * 3 / 4 : JACK_STACK_PREFAULT);
+}
+
+bool RtConfig::flushes_denormals() const {
+#if defined(__SSE__) || defined(__aarch64__)
+    return m_flushDenormals;
+#else
+    return false;
+#endif
+}
+
+void RtConfig::report(const char *name) const {
+    int policy;
+    struct sched_param spar;
+    pthread_getschedparam(pthread_self(), &policy, &spar);
+    char cpus[64] = "";
+    cpu_set_t set;
+    if (!sched_getaffinity(0, sizeof(set), &set)) {
+        size_t len = 0;
+        for (int c = 0; c < CPU_SETSIZE && len + 8 < sizeof(cpus); c++) {
+            if (CPU_ISSET(c, &set)) {
+                len += snprintf(cpus + len, sizeof(cpus) - len, len ? ",%i" : "%i", c);
+            }
+        }
+    }
+    bool flushed = false;
+#if defined(__SSE__)
+    flushed = (_mm_getcsr() & (_MM_FLUSH_ZERO_ON | 0x0040)) == (_MM_FLUSH_ZERO_ON | 0x0040);
+#elif defined(__aarch64__)
+    unsigned long fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    flushed = fpcr & (1UL << 24);
+#endif
+    fprintf(stderr, "%s: %s priority %i on cpus %s, denormals %s\n", name,
+            policy_name(policy), spar.sched_priority, cpus, flushed ? "flushed" : "kept");
+}
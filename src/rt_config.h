@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_RT_CONFIG_H_
+#define SRC_HEADERS_RT_CONFIG_H_
+
+#include <pthread.h>
+#include <ostream>
+#include <string>
+
+
+/* ------------- RtConfig ------------- */
+
+// how the DSP threads (the jack thread and the analysis workers) run.
+// Set from the config file and the command line before jack starts.
+class RtConfig {
+ public:
+    static RtConfig& instance();
+    // one setting by the key it has in the config file, false for an
+    // unknown key or a bad value
+    bool            set(const std::string& key, const std::string& value);
+    // all settings as config file lines
+    void            save(std::ostream& out) const;
+    // the realtime priority of the jack client, -1 when jack doesn't
+    // run realtime
+    void            set_jack_priority(int priority) { m_jackPriority = priority; }
+    // scheduling for the analysis workers, relative to jack
+    void            worker_sched(int *policy, int *priority) const;
+    // the cores for the workers, the configured ones where allowed,
+    // returns their number (at least 1)
+    int             worker_cpus(int *cpus, int max) const;
+    size_t          stack_size() const { return m_stackKb * 1024; }
+    // mlockall when [mlock] 1 is set, from main() before any thread
+    // starts. Off by default, it locks the whole GUI as well
+    void            lock_memory();
+    // flush denormals to zero and prefault the stack of the calling
+    // DSP thread, stack is its size or 0 when it isn't ours
+    void            setup_dsp_thread(size_t stack);
+    // whether setup_dsp_thread() flushes them on this cpu
+    bool            flushes_denormals() const;
+    // what the calling thread got
+    void            report(const char *name) const;
+ private:
+    RtConfig();
+    // workers run this much above (or below) jack
+    int             m_priorityOffset;
+    int             m_policy;
+    // e.g. "2,3" or "0-3", empty for all cores
+    std::string     m_cpus;
+    bool            m_mlock;
+    bool            m_flushDenormals;
+    int             m_stackKb;
+    int             m_jackPriority;
+};
+
+
+#endif  // SRC_HEADERS_RT_CONFIG_H_
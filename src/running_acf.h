@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** running autocorrelation
+ **
+ ** keeps the autocorrelation of the last WINDOW samples of a
+ ** SampleRing for LAGS lags up to date. The consumer brings it up
+ ** to the end of each analysis window, sample by sample from where
+ ** it left off, and only has to normalize it, no FFT is involved.
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_RUNNING_ACF_H_
+#define SRC_HEADERS_RUNNING_ACF_H_
+
+#include "spsc_ring.h"
+#include "pitch_kernels.h"
+
+
+/* ------------- RunningAcf ------------- */
+
+// r[t] = sum of x[i] * x[i-t] over the WINDOW newest samples x[i].
+// The sums are kept in double, so adding the newest and removing the
+// oldest product doesn't drift noticeable over a session.
+class RunningAcf {
+ public:
+    enum {
+        WINDOW = 1024,      // about 45ms at the analysis rate
+        LAGS = 640,         // down to 40Hz at 24kHz
+    };
+
+    RunningAcf() { reset(); }
+
+    // start over
+    void reset() {
+        memset(m_acc, 0, sizeof(m_acc));
+        m_fill = 0;
+        m_end = 0;
+    }
+    // account for the samples of ring up to position end. After a gap
+    // of more than WINDOW samples only the newest WINDOW are summed up.
+    // Returns false when the samples are overwritten or not there yet,
+    // the sums start over then.
+    bool update(const PitchKernels *k, const SampleRing& ring, unsigned int end) {
+        if (!m_fill || end - m_end > WINDOW) {
+            reset();
+            m_end = end - WINDOW;
+        }
+        const unsigned int oldest = m_end + 1 - (WINDOW + LAGS);
+        if (!ring.valid(oldest)) {
+            reset();
+            return false;
+        }
+        for (unsigned int t = m_end; t != end; t++) {
+            // m_acc is kept in reverse lag order, so both rows are
+            // read upwards: m_acc[j] is the lag LAGS-1-j
+            const float *p = ring.window(t + 1, WINDOW + LAGS);
+            const float a = p[WINDOW + LAGS - 1];
+            if (m_fill < WINDOW) {
+                k->acf_update(m_acc, p + WINDOW, p, a, 0.0f, LAGS);
+                m_fill++;
+            } else {
+                k->acf_update(m_acc, p + WINDOW, p, a, p[LAGS - 1], LAGS);
+            }
+        }
+        m_end = end;
+        if (!ring.valid(oldest)) {
+            reset();
+            return false;
+        }
+        return true;
+    }
+
+    // NSDF of the sums for the lags 1 .. LAGS-1 into nsdf[0 ..], p
+    // are the WINDOW + LAGS samples up to the last update. Returns
+    // the number of lags.
+    int nsdf(const float *p, float *nsdf) const {
+        const double *r = m_acc + LAGS - 1;
+        const float *x = p + LAGS;
+        double e0 = 0.0;
+        for (int i = 0; i < WINDOW; i++) {
+            e0 += sq(x[i]);
+        }
+        // energy of the window shifted back by t
+        double et = e0;
+        for (int t = 1; t < LAGS; t++) {
+            et += sq(x[-t]) - sq(x[WINDOW - t]);
+            double m = e0 + et;
+            nsdf[t - 1] = m > 0.0 ? 2.0 * r[-t] / m : 0.0;
+        }
+        return LAGS - 1;
+    }
+
+ private:
+    double          m_acc[LAGS];
+    int             m_fill;
+    // ring position the sums belong to
+    unsigned int    m_end;
+};
+
+
+#endif  // SRC_HEADERS_RUNNING_ACF_H_
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** lock-free single producer / single consumer containers
+ **
+ ** used to hand audio and analysis jobs from the jack thread
+ ** to the pitch tracker worker without locks or copies on the
+ ** realtime side.
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_SPSC_RING_H_
+#define SRC_HEADERS_SPSC_RING_H_
+
+#include <atomic>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// size of a cache line, used to keep producer and consumer data apart
+static const int CACHE_LINE = 64;
+
+
+/* ------------- SpscQueue ------------- */
+
+// bounded FIFO, Size must be a power of two
+template <class T, unsigned int Size>
+class SpscQueue {
+ public:
+    SpscQueue() : m_head(0), m_tail(0) {
+        static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+    }
+    // producer side
+    bool push(const T& v) {
+        unsigned int h = m_head.load(std::memory_order_relaxed);
+        if (h - m_tail.load(std::memory_order_acquire) >= Size) {
+            return false;
+        }
+        m_data[h & (Size - 1)] = v;
+        m_head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    // consumer side
+    bool pop(T& v) {
+        unsigned int t = m_tail.load(std::memory_order_relaxed);
+        if (t == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        v = m_data[t & (Size - 1)];
+        m_tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) ==
+               m_tail.load(std::memory_order_acquire);
+    }
+ private:
+    char                        pad0[CACHE_LINE];
+    std::atomic<unsigned int>   m_head;   // written by the producer
+    char                        pad1[CACHE_LINE];
+    std::atomic<unsigned int>   m_tail;   // written by the consumer
+    char                        pad2[CACHE_LINE];
+    T                           m_data[Size];
+};
+
+
+/* ------------- SampleRing ------------- */
+
+// history ring for audio samples. The producer never blocks, it
+// overwrites the oldest data. The consumer reads any window that
+// ends at a published position and is told when the producer
+// has lapped it.
+// The pages of the ring are mapped twice back to back, so every
+// window is one contiguous span. When that fails, the producer
+// mirrors the head of the ring into a guard area behind it.
+class SampleRing {
+ public:
+    // largest block the producer writes before publishing it
+    static const unsigned int MAX_CHUNK = 512;
+
+    SampleRing() : m_data(nullptr), m_size(0), m_mask(0), m_guard(0),
+        m_mapped(false), m_written(0) {}
+    ~SampleRing() { release(); }
+
+    // size must be a power of two, larger than any window + MAX_CHUNK,
+    // it may be enlarged to fit the page size
+    bool init(unsigned int size) {
+        if (size & (size - 1)) {
+            return false;
+        }
+        release();
+        unsigned int page = sysconf(_SC_PAGESIZE) / sizeof(float);
+        while (size < page || size % page) {
+            size *= 2;
+        }
+        m_size = size;
+        m_mask = size - 1;
+        m_mapped = map_mirror(size * sizeof(float));
+        if (!m_mapped) {
+            m_guard = size;
+            m_data = new float[size + m_guard];
+            memset(m_data, 0, (size + m_guard) * sizeof(*m_data));
+        }
+        m_written.store(0, std::memory_order_release);
+        return true;
+    }
+    unsigned int size() const { return m_size; }
+    bool is_mirrored() const { return m_mapped; }
+
+    // producer side, space is the number of samples which could be
+    // written to the returned pointer before calling commit()
+    float *write_ptr(unsigned int *space) const {
+        unsigned int idx = m_written.load(std::memory_order_relaxed) & m_mask;
+        *space = m_size - idx < MAX_CHUNK ? m_size - idx : MAX_CHUNK;
+        return &m_data[idx];
+    }
+    void commit(unsigned int n) {
+        unsigned int w = m_written.load(std::memory_order_relaxed);
+        unsigned int idx = w & m_mask;
+        if (idx < m_guard) {
+            unsigned int cnt = m_guard - idx < n ? m_guard - idx : n;
+            memcpy(&m_data[m_size + idx], &m_data[idx], cnt * sizeof(*m_data));
+        }
+        m_written.store(w + n, std::memory_order_release);
+    }
+    // consumer side
+    unsigned int written() const {
+        return m_written.load(std::memory_order_acquire);
+    }
+    // the n samples ending at position end as one contiguous span,
+    // check valid(end - n) when done with it
+    const float *window(unsigned int end, unsigned int n) const {
+        return &m_data[(end - n) & m_mask];
+    }
+    // whether the data from position start on is still untouched
+    bool valid(unsigned int start) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return written() - start + MAX_CHUNK <= m_size;
+    }
+ private:
+    bool map_mirror(size_t bytes) {
+        int fd = memfd_create("xtuner-ring", MFD_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        if (ftruncate(fd, bytes)) {
+            close(fd);
+            return false;
+        }
+        // reserve the address range first, then map the same pages twice
+        char *base = static_cast<char*>(mmap(NULL, 2 * bytes, PROT_NONE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (base == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        void *a = mmap(base, bytes, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_FIXED, fd, 0);
+        void *b = mmap(base + bytes, bytes, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_FIXED, fd, 0);
+        close(fd);
+        if (a != base || b != base + bytes) {
+            munmap(base, 2 * bytes);
+            return false;
+        }
+        m_data = reinterpret_cast<float*>(base);
+        return true;
+    }
+    void release() {
+        if (m_mapped) {
+            munmap(m_data, 2 * m_size * sizeof(float));
+        } else {
+            delete[] m_data;
+        }
+        m_data = nullptr;
+        m_mapped = false;
+        m_guard = 0;
+    }
+    float                       *m_data;
+    unsigned int                m_size;
+    unsigned int                m_mask;
+    unsigned int                m_guard;
+    bool                        m_mapped;
+    char                        pad0[CACHE_LINE];
+    std::atomic<unsigned int>   m_written;  // written by the producer
+    char                        pad1[CACHE_LINE];
+};
+
+
+#endif  // SRC_HEADERS_SPSC_RING_H_
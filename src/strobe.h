@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** strobe demodulator
+ **
+ ** mixes the input down with a reference oscillator at the note
+ ** to tune to and lowpasses the product. The phase of what is left
+ ** turns at the difference of both frequencies, just like the
+ ** pattern of a mechanical strobe tuner. Runs sample by sample on
+ ** the jack thread, no FFT is involved.
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_STROBE_H_
+#define SRC_HEADERS_STROBE_H_
+
+#include <math.h>
+#include <algorithm>
+
+
+// one reading of the strobe, handed to the GUI per hop
+struct StrobePhase {
+    float           phase;      // 0..1 turns against the reference
+    float           level;      // magnitude of the demodulated signal
+    float           reference;  // frequency it was taken against
+};
+
+
+/* ------------- StrobeDemodulator ------------- */
+
+class StrobeDemodulator {
+ public:
+    enum {
+        HOP = 256,          // about 80 readings per second
+    };
+
+    StrobeDemodulator()
+        : m_sampleRate(1), m_reference(0.0), m_cosw(1.0), m_sinw(0.0), m_alpha(0.0) {
+        reset();
+    }
+
+    // start over with the reference freq, 0 switches it off
+    void set_reference(float freq, int sampleRate) {
+        m_reference = freq;
+        m_sampleRate = sampleRate;
+        const double w = 2.0 * M_PI * freq / sampleRate;
+        m_cosw = cos(w);
+        m_sinw = sin(w);
+        // the image at twice the reference has to go, two poles
+        // at a quarter of it, but not slower than 15Hz
+        const double fc = std::min(15.0, 0.25 * freq);
+        m_alpha = 1.0 - exp(-2.0 * M_PI * fc / sampleRate);
+        reset();
+    }
+    float reference() const { return m_reference; }
+
+    // process n samples, returns true when out holds a new reading
+    bool process(const float *x, int n, StrobePhase *out) {
+        if (m_reference <= 0.0) {
+            return false;
+        }
+        bool ready = false;
+        for (int k = 0; k < n; k++) {
+            // x * e^-jwt
+            const double re = x[k] * m_c;
+            const double im = -x[k] * m_s;
+            m_re1 += m_alpha * (re - m_re1);
+            m_im1 += m_alpha * (im - m_im1);
+            m_re2 += m_alpha * (m_re1 - m_re2);
+            m_im2 += m_alpha * (m_im1 - m_im2);
+            const double c = m_c * m_cosw - m_s * m_sinw;
+            m_s = m_s * m_cosw + m_c * m_sinw;
+            m_c = c;
+            if (++m_fill < HOP) {
+                continue;
+            }
+            m_fill = 0;
+            // keep the oscillator on the unit circle
+            const double g = 1.0 / sqrt(m_c * m_c + m_s * m_s);
+            m_c *= g;
+            m_s *= g;
+            double ph = atan2(m_im2, m_re2) / (2.0 * M_PI);
+            out->phase = ph < 0.0 ? ph + 1.0 : ph;
+            out->level = 2.0 * sqrt(m_re2 * m_re2 + m_im2 * m_im2);
+            out->reference = m_reference;
+            ready = true;
+        }
+        return ready;
+    }
+
+ private:
+    void reset() {
+        m_c = 1.0;
+        m_s = 0.0;
+        m_re1 = m_im1 = m_re2 = m_im2 = 0.0;
+        m_fill = 0;
+    }
+
+    int             m_sampleRate;
+    float           m_reference;
+    double          m_cosw, m_sinw, m_alpha;
+    // oscillator and lowpass state
+    double          m_c, m_s;
+    double          m_re1, m_im1, m_re2, m_im2;
+    int             m_fill;
+};
+
+
+#endif  // SRC_HEADERS_STROBE_H_
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** strum analyzer
+ **
+ ** measures all strings of a strummed chord at once. For every
+ ** expected open string one partial is picked which no other
+ ** string covers, the spectrum of a long window is evaluated only
+ ** around it (±50 cent) and the peak is interpolated.
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_STRUM_ANALYZER_H_
+#define SRC_HEADERS_STRUM_ANALYZER_H_
+
+#include <math.h>
+#include <algorithm>
+#include "pitch_estimators.h"
+
+
+/* ------------- StrumAnalyzer ------------- */
+
+class StrumAnalyzer {
+ public:
+    enum {
+        MAX_STRINGS = 8,
+        WINDOW = 4096,      // about 180ms at the analysis rate
+        PARTIALS = 4,       // partials of the other strings to avoid
+    };
+
+    StrumAnalyzer() : m_sampleRate(0), m_count(0) {
+        for (int j = 0; j < WINDOW; j++) {
+            m_hann[j] = 0.5f - 0.5f * cosf(2.0f * M_PI * j / (WINDOW - 1));
+        }
+    }
+
+    // expected open strings, count 0 switches the analysis off
+    void set_strings(const float *freqs, int count, int sampleRate) {
+        m_count = count < MAX_STRINGS ? count : MAX_STRINGS;
+        m_sampleRate = sampleRate;
+        // two main lobe widths of the Hann window
+        const float clear = 4.0f * sampleRate / WINDOW;
+        for (int i = 0; i < m_count; i++) {
+            m_expected[i] = freqs[i];
+            m_partial[i] = 1;
+            for (int h = 1; h <= 3; h++) {
+                if (!collides(h * freqs[i], i, freqs, clear)) {
+                    m_partial[i] = h;
+                    break;
+                }
+            }
+        }
+    }
+    int count() const { return m_count; }
+
+    // measure the strings in the WINDOW samples at input, writes
+    // the fundamental of each string (0 when it doesn't sound) to freqs
+    void analyse(const float *input, float *freqs) {
+        for (int j = 0; j < WINDOW; j++) {
+            m_windowed[j] = input[j] * m_hann[j];
+        }
+        float level[MAX_STRINGS];
+        float loudest = 0.0;
+        for (int i = 0; i < m_count; i++) {
+            freqs[i] = find_peak(m_partial[i] * m_expected[i], &level[i]) / m_partial[i];
+            loudest = level[i] > loudest ? level[i] : loudest;
+        }
+        for (int i = 0; i < m_count; i++) {
+            // 30dB below the loudest string is leakage
+            if (level[i] < loudest * 1e-3f || level[i] < 1e-6f) {
+                freqs[i] = 0.0;
+            }
+        }
+    }
+
+ private:
+    bool collides(float f, int self, const float *freqs, float clear) const {
+        for (int j = 0; j < m_count; j++) {
+            if (j == self) {
+                continue;
+            }
+            for (int k = 1; k <= PARTIALS; k++) {
+                if (fabsf(f - k * freqs[j]) < clear) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // power of the windowed signal at frequency f (Goertzel)
+    float power(float f) const {
+        const double w = 2.0 * M_PI * f / m_sampleRate;
+        const double c = 2.0 * cos(w);
+        double s1 = 0.0, s2 = 0.0;
+        for (int j = 0; j < WINDOW; j++) {
+            double s0 = m_windowed[j] + c * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        return static_cast<float>(s1 * s1 + s2 * s2 - c * s1 * s2);
+    }
+
+    // strongest frequency within 50 cent of f, scanned in steps of a
+    // quarter main lobe and refined on the log power
+    float find_peak(float f, float *level) const {
+        const float lo = f * 0.971532f;
+        const float hi = f * 1.029302f;
+        const float lobe = 2.0f * m_sampleRate / WINDOW;
+        const int steps = std::max(4, static_cast<int>((hi - lo) / (lobe / 4)) + 1);
+        const float step = (hi - lo) / steps;
+        float p[64];
+        const int n = std::min(steps + 1, 64);
+        int best = 0;
+        for (int k = 0; k < n; k++) {
+            p[k] = power(lo + k * step);
+            if (p[k] > p[best]) {
+                best = k;
+            }
+        }
+        *level = p[best] / (0.25f * WINDOW * WINDOW);
+        if (best == 0 || best == n - 1) {
+            // beyond 50 cent, show it at the end of the scale
+            return lo + best * step;
+        }
+        const float eps = 1e-20;
+        float x;
+        parabolaTurningPoint(logf(p[best-1] + eps), logf(p[best] + eps),
+                             logf(p[best+1] + eps), best, &x);
+        return lo + x * step;
+    }
+
+    int             m_sampleRate;
+    int             m_count;
+    float           m_expected[MAX_STRINGS];
+    int             m_partial[MAX_STRINGS];
+    float           m_hann[WINDOW];
+    float           m_windowed[WINDOW];
+};
+
+
+#endif  // SRC_HEADERS_STRUM_ANALYZER_H_
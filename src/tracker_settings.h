@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** tracker settings
+ **
+ ** the settings the jack thread and the worker have to see together:
+ ** the band limit, the signal thresholds and the hop period. A control thread builds
+ ** a new snapshot, computes the filter coefficients and swaps the
+ ** pointer. Readers take the pointer, copy what they need and
+ ** release it. Each reader counts up its epoch on both, so it is odd
+ ** while the reader holds a snapshot. The old snapshot is freed by
+ ** the next publisher once no reader held it at the swap or each one
+ ** which did moved on, so an idle reader holds nothing back and the
+ ** realtime side never allocates, frees or waits.
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_TRACKER_SETTINGS_H_
+#define SRC_HEADERS_TRACKER_SETTINGS_H_
+
+#include <atomic>
+#include <vector>
+#include "lhc_bank.h"
+
+
+struct TrackerSettings {
+    // counts up with each publish
+    unsigned int    version;
+    // the analysis rate it was made for, nothing is published before
+    // the rate is known
+    int             sample_rate;
+    // time between two analysis windows in seconds, the jack thread
+    // turns it into a hop at sample_rate
+    float           period;
+    // band limit corners in Hz and the coefficients at the analysis rate
+    float           low_cut;
+    float           high_cut;
+    LhcCoefs        coefs;
+    // level above which a signal starts, and below which it ends
+    float           threshold_on;
+    float           threshold_off;
+};
+
+
+/* ------------- SettingsExchange ------------- */
+
+// one publisher, READERS readers which each hold at most one snapshot
+class SettingsExchange {
+ public:
+    enum {
+        READER_JACK,
+        READER_WORKER,
+        READERS,
+    };
+
+    SettingsExchange() : m_current(nullptr) {
+        for (int i = 0; i < READERS; i++) {
+            m_epoch[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    ~SettingsExchange() {
+        delete m_current.load(std::memory_order_relaxed);
+        for (auto& r : m_retired) {
+            delete r.settings;
+        }
+    }
+
+    // publisher side, takes ownership of s
+    void publish(TrackerSettings *s) {
+        // seq_cst on both sides: either the reader sees s, or we see
+        // its odd epoch and keep the old one
+        TrackerSettings *old = m_current.exchange(s, std::memory_order_seq_cst);
+        reclaim();
+        if (old) {
+            Retired r;
+            r.settings = old;
+            for (int i = 0; i < READERS; i++) {
+                r.epoch[i] = m_epoch[i].load(std::memory_order_seq_cst);
+            }
+            m_retired.push_back(r);
+        }
+    }
+
+    // reader side, the snapshot stays valid until release(reader)
+    const TrackerSettings *acquire(int reader) {
+        m_epoch[reader].fetch_add(1, std::memory_order_seq_cst);
+        return m_current.load(std::memory_order_seq_cst);
+    }
+    void release(int reader) {
+        m_epoch[reader].fetch_add(1, std::memory_order_seq_cst);
+    }
+
+ private:
+    struct Retired {
+        TrackerSettings *settings;
+        unsigned int    epoch[READERS];
+    };
+
+    // free the snapshots no reader can hold any more: it held none when
+    // they were retired (even epoch) or it released since
+    void reclaim() {
+        unsigned int now[READERS];
+        for (int i = 0; i < READERS; i++) {
+            now[i] = m_epoch[i].load(std::memory_order_seq_cst);
+        }
+        size_t keep = 0;
+        for (size_t j = 0; j < m_retired.size(); j++) {
+            bool done = true;
+            for (int i = 0; i < READERS; i++) {
+                const unsigned int e = m_retired[j].epoch[i];
+                done = done && (!(e & 1) || now[i] != e);
+            }
+            if (done) {
+                delete m_retired[j].settings;
+            } else {
+                m_retired[keep++] = m_retired[j];
+            }
+        }
+        m_retired.resize(keep);
+    }
+
+    std::atomic<TrackerSettings*> m_current;
+    std::atomic<unsigned int> m_epoch[READERS];
+    // publisher only
+    std::vector<Retired> m_retired;
+};
+
+
+#endif  // SRC_HEADERS_TRACKER_SETTINGS_H_
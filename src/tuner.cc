@@ -25,6 +25,7 @@
  * --------------------------------------------------------------------------
  */
 
+#include <unistd.h>
 #include "gx_pitch_tracker.h"
 
 /****************************************************************
@@ -33,41 +34,141 @@
 
 class tuner {
 private:
-    PitchTracker pitch_tracker;
+    // swapped when the rate or the window size changes, the jack thread
+    // sets in_process around each use, all other threads hold rebuild,
+    // so the old one can be freed once in_process is seen clear
+    std::atomic<PitchTracker*> pitch_tracker;
+    std::atomic<bool> in_process;
+    std::mutex rebuild;
+    unsigned int rate;
+    int fft_size;
+    sigc::signal<void > new_freq;
     int state;
     enum { tuner_use = 0x01, livetuner_use = 0x02, switcher_use = 0x04, midi_use = 0x08 };
     void set_and_check(int use, bool on);
+    PitchTracker *tracker() { return pitch_tracker.load(std::memory_order_acquire); }
+    // the tracker for the GUI and control threads, rebuild is held
+    // until the end of the full expression, so it isn't swapped meanwhile
+    class locked {
+    private:
+        std::unique_lock<std::mutex> lk;
+        PitchTracker *t;
+    public:
+        explicit locked(tuner& self) : lk(self.rebuild), t(self.tracker()) {}
+        PitchTracker *operator->() const { return t; }
+    };
+    // the tracker for the jack thread, valid until leave()
+    PitchTracker *enter() {
+        in_process.store(true, std::memory_order_seq_cst);
+        return pitch_tracker.load(std::memory_order_seq_cst);
+    }
+    void leave() { in_process.store(false, std::memory_order_release); }
+    friend class tuner_bank;
+    void start(PitchTracker *t, unsigned int samplingFreq);
+    void replace(unsigned int samplingFreq, int n);
 public:
-    sigc::signal<void >& signal_freq_changed() { return pitch_tracker.new_freq; }
+    sigc::signal<void >& signal_freq_changed() { return new_freq; }
    // Glib::Dispatcher& signal_freq_changed() { return pitch_tracker.new_freq; }
     static void feed_tuner(int count, float *input, float *output, tuner&);
+    static void feed_wide(int count, float *input, tuner&);
     static int activate(bool start, tuner& self);
     static void init(unsigned int samplingFreq, tuner& self);
+    // a new rate from the jack server, builds a new tracker on the
+    // calling thread and swaps it in
+    static void set_sample_rate(unsigned int samplingFreq, tuner& self);
+    // largest analysis window, the same swap once running
+    static void set_fft_size(tuner& self, int n);
     static void del_instance(tuner& self);
-    static float get_freq(tuner& self) { return self.pitch_tracker.get_estimated_freq(); }
-    static float get_note(tuner& self) { return self.pitch_tracker.get_estimated_note(); }
+    static float get_freq(tuner& self) { return locked(self)->get_estimated_freq(); }
+    static unsigned int get_frame(tuner& self) { return locked(self)->get_estimate_frame(); }
+    static float get_note(tuner& self) { return locked(self)->get_estimated_note(); }
     static inline float db2power(float db) {return pow(10.,db*0.05);}
-    static void set_threshold_level(tuner& self,float v) {self.pitch_tracker.set_threshold(db2power(v)); }
-    static void set_fast_note(tuner& self,bool v) {self.pitch_tracker.set_fast_note_detection(v); }
+    static void set_threshold_level(tuner& self,float v) {locked(self)->set_threshold(db2power(v)); }
+    static void set_fast_note(tuner& self,bool v) {locked(self)->set_fast_note_detection(v); }
+    static void set_extended_range(tuner& self,bool v) {locked(self)->set_extended_range(v); }
+    static void set_running_acf(tuner& self,bool v) {locked(self)->set_running_acf(v); }
+    static void set_target(tuner& self,float v) {locked(self)->set_target(v); }
+    static void set_estimator(tuner& self,int v) {locked(self)->set_estimator(v); }
+    static int estimator_count() {return PitchTracker::estimator_count(); }
+    static const char *estimator_name(int i) {return PitchTracker::estimator_name(i); }
+    static void set_strum_strings(tuner& self,const float *freqs, int count) {locked(self)->set_strum_strings(freqs, count); }
+    static int get_strum_freqs(tuner& self,float *freqs, int max) {return locked(self)->get_strum_freqs(freqs, max); }
+    static void set_hop_time(tuner& self,float ms) {locked(self)->set_hop_time(ms); }
+    static void get_stats(tuner& self, TrackerStats *stats) {locked(self)->get_stats(stats); }
+    static void set_smoothing(tuner& self,bool v) {locked(self)->set_smoothing(v); }
+    static void set_refine(tuner& self,bool v) {locked(self)->set_refine(v); }
+    static void set_band(tuner& self,float low, float high) {locked(self)->set_band(low, high); }
+    static void set_strobe(tuner& self,float v) {locked(self)->set_strobe(v); }
+    static void set_synchronous(tuner& self,float budget) {locked(self)->set_synchronous(budget); }
+    static bool get_strobe(tuner& self,StrobePhase *p) {return locked(self)->get_strobe(p); }
+    static void get_filter_stats(tuner& self, FilterStats *stats) {locked(self)->get_filter_stats(stats); }
     tuner();
-    ~tuner() {};
+    ~tuner() { tracker()->stop_thread(); delete tracker(); }
 };
 
 tuner::tuner()
     : // trackable(),
-      pitch_tracker(),
-      state() {}
+      pitch_tracker(PitchTracker::create(2048)),
+      in_process(false),
+      rate(0),
+      fft_size(2048),
+      state() {
+    tracker()->new_freq.connect(new_freq.make_slot());
+}
 
 void tuner::init(unsigned int samplingFreq, tuner& self) {
-    int priority = 0, policy = 0;
-#ifdef _POSIX_PRIORITY_SCHEDULING
-    int priomax = sched_get_priority_max(SCHED_FIFO);
-    if ((priomax/2.2) > 0) {
-        priority = priomax/2.2;
-        policy = SCHED_FIFO;
+    std::unique_lock<std::mutex> lk(self.rebuild);
+    self.start(self.tracker(), samplingFreq);
+    self.rate = samplingFreq;
+}
+
+void tuner::set_sample_rate(unsigned int samplingFreq, tuner& self) {
+    std::unique_lock<std::mutex> lk(self.rebuild);
+    // the callback fires on activation too, before init()
+    if (self.rate && samplingFreq != self.rate) {
+        self.replace(samplingFreq, self.fft_size);
+    }
+}
+
+void tuner::set_fft_size(tuner& self, int n) {
+    std::unique_lock<std::mutex> lk(self.rebuild);
+    if (n == self.fft_size) {
+        return;
+    }
+    if (self.rate) {
+        self.replace(self.rate, n);
+    } else {
+        PitchTracker *t = PitchTracker::create(n);
+        t->copy_settings(*self.tracker());
+        t->new_freq.connect(self.new_freq.make_slot());
+        delete self.pitch_tracker.exchange(t);
+    }
+    self.fft_size = n;
+}
+
+// build, swap and stop the old one, called with rebuild held
+void tuner::replace(unsigned int samplingFreq, int n) {
+    PitchTracker *old = tracker();
+    PitchTracker *t = PitchTracker::create(n);
+    t->copy_settings(*old);
+    t->new_freq.connect(new_freq.make_slot());
+    start(t, samplingFreq);
+    pitch_tracker.store(t, std::memory_order_seq_cst);
+    // in_process is set before the pointer is read, once it is seen
+    // clear the jack thread can only get the new one
+    while (in_process.load(std::memory_order_seq_cst)) {
+        usleep(1000);
     }
-#endif
-    self.pitch_tracker.init(policy, priority, samplingFreq);
+    // the GUI gets at it only with rebuild held
+    old->stop_thread();
+    delete old;
+    rate = samplingFreq;
+}
+
+void tuner::start(PitchTracker *t, unsigned int samplingFreq) {
+    int priority, policy;
+    RtConfig::instance().worker_sched(&policy, &priority);
+    t->init(priority, policy, samplingFreq);
 }
 
 void tuner::set_and_check(int use, bool on) {
@@ -77,22 +178,139 @@ void tuner::set_and_check(int use, bool on) {
         state &= ~use;
     }
     if (use == switcher_use) {
-        pitch_tracker.set_fast_note_detection(on);
+        locked(*this)->set_fast_note_detection(on);
     }
 }
 
 int tuner::activate(bool start, tuner& self) {
     if (!start) {
-        self.pitch_tracker.reset();
+        locked(self)->reset();
     }
     return 0;
 }
 
 void tuner::feed_tuner(int count, float* input, float*, tuner& self) {
-    self.pitch_tracker.add(count, input);
+    self.enter()->add(count, input);
+    self.leave();
+}
+
+void tuner::feed_wide(int count, float* input, tuner& self) {
+    self.enter()->add_wide(count, input);
+    self.leave();
 }
 
 void tuner::del_instance(tuner& self)
 {
     delete &self;
 }
+
+
+/****************************************************************
+ ** class tuner_bank
+ **
+ ** the tuners of all inputs of one jack client. Each input is
+ ** decimated on its own, the band limit runs over all of them at
+ ** once in one LowHighCutBank, and each tracker gets its channel
+ ** with add_decimated(). One pass per jack period for all inputs.
+ */
+
+class tuner_bank {
+private:
+    enum { MAX_CHANNELS = LowHighCutBank::MAX_CHANNELS };
+    int channels;
+    tuner *tuners[MAX_CHANNELS];
+    // decimation for the host rate, from the rate callbacks
+    std::atomic<int> host_stages;
+    // front end state, jack thread only
+    Decimator decimators[MAX_CHANNELS];
+    int stages;
+    LowHighCutBank lhc;
+    float scratch[MAX_CHANNELS][SampleRing::MAX_CHUNK];
+public:
+    static const int max_channels = MAX_CHANNELS;
+    explicit tuner_bank(int n);
+    ~tuner_bank();
+    int size() const { return channels; }
+    tuner& channel(int i) { return *tuners[i]; }
+    static void init(unsigned int samplingFreq, tuner_bank& self);
+    static void set_sample_rate(unsigned int samplingFreq, tuner_bank& self);
+    // one period of all inputs starting at jack frame frame, runs on
+    // the jack thread
+    static void feed(int count, float *const *inputs, unsigned int frame, tuner_bank& self);
+};
+
+tuner_bank::tuner_bank(int n)
+    : channels(std::max(1, std::min(n, static_cast<int>(MAX_CHANNELS)))),
+      host_stages(0),
+      stages(-1),
+      lhc() {
+    for (int c = 0; c < channels; c++) {
+        tuners[c] = new tuner();
+    }
+}
+
+tuner_bank::~tuner_bank() {
+    for (int c = 0; c < channels; c++) {
+        delete tuners[c];
+    }
+}
+
+void tuner_bank::init(unsigned int samplingFreq, tuner_bank& self) {
+    for (int c = 0; c < self.channels; c++) {
+        tuner::init(samplingFreq, *self.tuners[c]);
+    }
+    self.lhc.init(tuner::locked(*self.tuners[0])->analysis_rate(), self.channels);
+    self.lhc.set_flushed(RtConfig::instance().flushes_denormals());
+    self.host_stages.store(PitchTracker::decimation_stages(samplingFreq), std::memory_order_relaxed);
+}
+
+void tuner_bank::set_sample_rate(unsigned int samplingFreq, tuner_bank& self) {
+    for (int c = 0; c < self.channels; c++) {
+        tuner::set_sample_rate(samplingFreq, *self.tuners[c]);
+    }
+    self.host_stages.store(PitchTracker::decimation_stages(samplingFreq), std::memory_order_relaxed);
+}
+
+void tuner_bank::feed(int count, float *const *inputs, unsigned int frame, tuner_bank& self) {
+    PitchTracker *t[MAX_CHANNELS] = {};
+    float *io[MAX_CHANNELS];
+    for (int c = 0; c < self.channels; c++) {
+        t[c] = self.tuners[c]->enter();
+        t[c]->add_wide(count, inputs[c]);
+        io[c] = self.scratch[c];
+    }
+    // the stages follow the host rate, not a tracker, which may still
+    // be one built for the old rate
+    const int st = self.host_stages.load(std::memory_order_relaxed);
+    if (st != self.stages) {
+        for (int c = 0; c < self.channels; c++) {
+            self.decimators[c].setup(st);
+        }
+        self.lhc.clear_state();
+        self.stages = st;
+    }
+    for (int c = 0; c < self.channels; c++) {
+        // each channel filters with the band of its own tracker
+        self.lhc.set_coefs(c, t[c]->band_coefs());
+        t[c]->begin_period(frame, count, self.decimators[c].phase());
+    }
+    int done = 0;
+    while (done < count) {
+        // the decimators run in lockstep, so they all take the same
+        const int in = std::min(count - done, self.decimators[0].inputs_for(SampleRing::MAX_CHUNK));
+        int n = 0;
+        for (int c = 0; c < self.channels; c++) {
+            n = self.decimators[c].process(inputs[c] + done, in, self.scratch[c]);
+        }
+        done += in;
+        if (n) {
+            self.lhc.compute(n, io);
+            for (int c = 0; c < self.channels; c++) {
+                t[c]->add_decimated(n, self.scratch[c]);
+            }
+        }
+    }
+    for (int c = 0; c < self.channels; c++) {
+        self.tuners[c]->leave();
+    }
+}
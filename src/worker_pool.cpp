@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** analysis worker pool
+ **
+ ** replaces the thread per pitch tracker. The jack thread only
+ ** pushes into the SPSC inbox of a worker and posts its semaphore
+ ** when it sleeps. The heaps are only locked by the workers, the
+ ** owner to run its next task and idle ones to steal.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <algorithm>
+
+
+WorkerPool& WorkerPool::instance() {
+    static WorkerPool pool;
+    return pool;
+}
+
+WorkerPool::WorkerPool()
+    : m_count(0),
+      m_tasks(0),
+      m_cores(1),
+      m_exit(false) {
+    m_cpus[0] = 0;
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        m_workers[i].size = 0;
+        m_workers[i].busy.store(false, std::memory_order_relaxed);
+        m_workers[i].pool = this;
+        m_workers[i].index = i;
+        sem_init(&m_workers[i].wake, 0, 0);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    m_exit.store(true, std::memory_order_seq_cst);
+    const int count = m_count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        sem_post(&m_workers[i].wake);
+        pthread_join(m_workers[i].thread, NULL);
+    }
+    for (int i = 0; i < MAX_WORKERS; i++) {
+        sem_destroy(&m_workers[i].wake);
+    }
+}
+
+// one more worker, pinned to the next core
+bool WorkerPool::start_worker(int policy, int priority) {
+    const int i = m_count.load(std::memory_order_relaxed);
+    Worker& w = m_workers[i];
+    pthread_attr_t      attr;
+    struct sched_param  spar;
+    spar.sched_priority = priority;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_JOINABLE );
+    pthread_attr_setschedpolicy(&attr, policy);
+    pthread_attr_setschedparam(&attr, &spar);
+    pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setstacksize(&attr, RtConfig::instance().stack_size());
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(m_cpus[i], &cpus);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    int err = pthread_create(&w.thread, &attr, static_run, reinterpret_cast<void*>(&w));
+    if (err == EPERM && policy != SCHED_OTHER) {
+        // no realtime rights, better a plain thread than none
+        fprintf(stderr, "analysis worker %i: can't get realtime priority %i, running without\n",
+                i, priority);
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        err = pthread_create(&w.thread, &attr, static_run, reinterpret_cast<void*>(&w));
+    }
+    pthread_attr_destroy(&attr);
+    if (err) {
+        fprintf(stderr, "analysis worker %i: %s\n", i, strerror(err));
+        return false;
+    }
+    m_count.store(i + 1, std::memory_order_release);
+    return true;
+}
+
+bool WorkerPool::add(PoolTask *t, int policy, int priority) {
+    std::unique_lock<std::mutex> lk(m_lock);
+    if (m_tasks >= MAX_TASKS) {
+        return false;
+    }
+    if (!m_count.load(std::memory_order_relaxed)) {
+        // the cores the config allows, the workers take them in turn
+        m_cores = RtConfig::instance().worker_cpus(m_cpus, MAX_WORKERS);
+        for (int i = m_cores; i < MAX_WORKERS; i++) {
+            m_cpus[i] = m_cpus[i % m_cores];
+        }
+    }
+    if (m_count.load(std::memory_order_relaxed) < std::min(m_tasks + 1, m_cores)) {
+        if (!start_worker(policy, priority) && !m_count.load(std::memory_order_relaxed)) {
+            return false;
+        }
+    }
+    t->m_retiring.store(false, std::memory_order_relaxed);
+    t->m_home = m_tasks % m_count.load(std::memory_order_relaxed);
+    m_tasks++;
+    return true;
+}
+
+void WorkerPool::remove(PoolTask *t) {
+    t->m_retiring.store(true, std::memory_order_seq_cst);
+    // a worker drops the task when it gets it, it isn't queued again
+    while (t->m_queued.load(std::memory_order_seq_cst) ||
+           t->m_active.load(std::memory_order_seq_cst)) {
+        usleep(1000);
+    }
+    std::unique_lock<std::mutex> lk(m_lock);
+    m_tasks--;
+}
+
+void WorkerPool::submit(PoolTask *t, unsigned long deadline) {
+    if (t->m_queued.exchange(true, std::memory_order_seq_cst)) {
+        // queued or running, the worker looks for more when done
+        return;
+    }
+    // the home worker, or any idle one when it is busy
+    const int count = m_count.load(std::memory_order_acquire);
+    Worker *w = &m_workers[t->m_home];
+    for (int i = 0; i < count && w->busy.load(std::memory_order_relaxed); i++) {
+        if (!m_workers[i].busy.load(std::memory_order_relaxed)) {
+            w = &m_workers[i];
+        }
+    }
+    Entry e = { deadline, t };
+    // can't fail, a task is in at most one queue at a time
+    w->inbox.push(e);
+    // pairs with the fence in run(), the worker either sees
+    // the entry or we see that it is about to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!w->busy.load(std::memory_order_relaxed)) {
+        sem_post(&w->wake);
+    }
+}
+
+bool WorkerPool::run_inline(PoolTask *t) {
+    // taken like a worker takes it, so none gets it meanwhile
+    if (t->m_queued.exchange(true, std::memory_order_seq_cst)) {
+        return false;
+    }
+    t->m_active.store(true, std::memory_order_seq_cst);
+    if (!t->m_retiring.load(std::memory_order_seq_cst)) {
+        t->m_inline = true;
+        t->process();
+        t->m_inline = false;
+    }
+    t->m_queued.store(false, std::memory_order_seq_cst);
+    t->m_active.store(false, std::memory_order_seq_cst);
+    return true;
+}
+
+void WorkerPool::heap_push(Worker& w, const Entry& e) {
+    int i = w.size++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (w.heap[parent].deadline <= e.deadline) {
+            break;
+        }
+        w.heap[i] = w.heap[parent];
+        i = parent;
+    }
+    w.heap[i] = e;
+}
+
+WorkerPool::Entry WorkerPool::heap_pop(Worker& w) {
+    Entry top = w.heap[0];
+    Entry last = w.heap[--w.size];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= w.size) {
+            break;
+        }
+        if (c + 1 < w.size && w.heap[c + 1].deadline < w.heap[c].deadline) {
+            c++;
+        }
+        if (last.deadline <= w.heap[c].deadline) {
+            break;
+        }
+        w.heap[i] = w.heap[c];
+        i = c;
+    }
+    w.heap[i] = last;
+    return top;
+}
+
+// the task due first, from the own heap or stolen from another one
+bool WorkerPool::take(Worker& w, Entry *e) {
+    bool more = false;
+    {
+        std::unique_lock<std::mutex> lk(w.lock);
+        Entry n;
+        while (w.inbox.pop(n)) {
+            heap_push(w, n);
+        }
+        if (w.size) {
+            *e = heap_pop(w);
+            more = w.size > 0;
+        }
+    }
+    const int count = m_count.load(std::memory_order_acquire);
+    if (more) {
+        // let an idle worker steal the rest
+        for (int i = 0; i < count; i++) {
+            if (i != w.index && !m_workers[i].busy.load(std::memory_order_relaxed)) {
+                sem_post(&m_workers[i].wake);
+                break;
+            }
+        }
+        return true;
+    }
+    if (e->task) {
+        return true;
+    }
+    for (int i = 1; i < count; i++) {
+        Worker& v = m_workers[(w.index + i) % count];
+        std::unique_lock<std::mutex> lk(v.lock, std::try_to_lock);
+        if (lk.owns_lock() && v.size) {
+            *e = heap_pop(v);
+            return true;
+        }
+    }
+    return false;
+}
+
+void *WorkerPool::static_run(void *p) {
+    Worker *w = reinterpret_cast<Worker*>(p);
+    w->pool->run(*w);
+    return NULL;
+}
+
+void WorkerPool::run(Worker& w) {
+    RtConfig& rt = RtConfig::instance();
+    rt.setup_dsp_thread(rt.stack_size());
+    char name[32];
+    snprintf(name, sizeof(name), "analysis worker %i", w.index);
+    rt.report(name);
+    w.busy.store(true, std::memory_order_relaxed);
+    while (!m_exit.load(std::memory_order_relaxed)) {
+        Entry e = { 0, NULL };
+        if (!take(w, &e)) {
+            w.busy.store(false, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (w.inbox.empty()) {
+                sem_wait(&w.wake);
+            }
+            w.busy.store(true, std::memory_order_relaxed);
+            continue;
+        }
+        PoolTask *t = e.task;
+        t->m_active.store(true, std::memory_order_seq_cst);
+        if (!t->m_retiring.load(std::memory_order_seq_cst)) {
+            t->process();
+        }
+        t->m_queued.store(false, std::memory_order_seq_cst);
+        // work which came in meanwhile wasn't queued, it keeps the
+        // deadline it missed
+        if (!t->m_retiring.load(std::memory_order_seq_cst) && t->pending()
+            && !t->m_queued.exchange(true, std::memory_order_seq_cst)) {
+            std::unique_lock<std::mutex> lk(w.lock);
+            heap_push(w, e);
+        }
+        t->m_active.store(false, std::memory_order_seq_cst);
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_WORKER_POOL_H_
+#define SRC_HEADERS_WORKER_POOL_H_
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <atomic>
+#include <mutex>
+#include "spsc_ring.h"
+#include "rt_config.h"
+
+
+/* ------------- PoolTask ------------- */
+
+// work for the pool, e.g. a pitch tracker with windows to analyse.
+// A task is queued at most once at a time, so it never runs on two
+// workers at once and keeps its state without locks.
+class PoolTask {
+ public:
+    PoolTask() : m_queued(false), m_active(false), m_retiring(false), m_home(0), m_inline(false) {}
+    virtual ~PoolTask() {}
+    // handle one piece of work, runs on a worker
+    virtual void    process() = 0;
+    // whether there is more to do
+    virtual bool    pending() const = 0;
+ protected:
+    // process() was called by run_inline(), on the jack thread
+    bool            running_inline() const { return m_inline; }
+ private:
+    friend class WorkerPool;
+    // in a queue or running, set by the one who queues it
+    std::atomic<bool> m_queued;
+    // a worker holds the task
+    std::atomic<bool> m_active;
+    // on its way out, don't queue it again
+    std::atomic<bool> m_retiring;
+    // the worker it is handed to first
+    int             m_home;
+    // written by the holder of m_queued only
+    bool            m_inline;
+};
+
+
+/* ------------- WorkerPool ------------- */
+
+// process wide analysis threads, one per core up to the number of
+// tasks. The jack thread queues a task with its deadline into the
+// lock-free inbox of a worker, each worker runs the task due first and
+// idle workers steal from the others.
+class WorkerPool {
+ public:
+    enum {
+        MAX_WORKERS = 16,
+        MAX_TASKS = 64,
+    };
+
+    static WorkerPool& instance();
+    // make t known and start workers as needed, not on the jack thread
+    bool            add(PoolTask *t, int policy, int priority);
+    // no worker touches t once this returns, not on the jack thread
+    void            remove(PoolTask *t);
+    // t has work due by deadline (in microseconds), called by the jack
+    // thread, which is the only one to do so
+    void            submit(PoolTask *t, unsigned long deadline);
+    // run t on the calling thread unless a worker holds it, for the
+    // same thread as submit()
+    bool            run_inline(PoolTask *t);
+    int             workers() const { return m_count.load(std::memory_order_acquire); }
+ private:
+    struct Entry {
+        unsigned long   deadline;
+        PoolTask        *task;
+    };
+    struct Worker {
+        SpscQueue<Entry, MAX_TASKS> inbox;
+        // min heap by deadline, guarded by lock
+        std::mutex      lock;
+        Entry           heap[MAX_TASKS];
+        int             size;
+        sem_t           wake;
+        std::atomic<bool> busy;
+        pthread_t       thread;
+        WorkerPool      *pool;
+        int             index;
+    };
+    WorkerPool();
+    ~WorkerPool();
+    static void     *static_run(void *p);
+    void            run(Worker& w);
+    bool            take(Worker& w, Entry *e);
+    static void     heap_push(Worker& w, const Entry& e);
+    static Entry    heap_pop(Worker& w);
+    bool            start_worker(int policy, int priority);
+    std::mutex      m_lock;             // add() and remove()
+    Worker          m_workers[MAX_WORKERS];
+    std::atomic<int> m_count;
+    int             m_tasks;
+    int             m_cores;
+    // core of each worker, from RtConfig
+    int             m_cpus[MAX_WORKERS];
+    std::atomic<bool> m_exit;
+};
+
+
+#endif  // SRC_HEADERS_WORKER_POOL_H_
@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <thread>
+#include <chrono>
 #include <system_error>
 #include <fstream>
 #include <iostream>
@@ -35,13 +36,15 @@
 
 #include "NsmHandler.h"
 #include "gx_pitch_tracker.h"
+#include "fft_plans.cpp"
+#include "rt_config.cpp"
+#include "worker_pool.cpp"
 #include "gx_pitch_tracker.cpp"
-#include "low_high_cut.cc"
 #include "tuner.cc"
 
 #include "xwidgets.h"
 
-//   g++ -O2 -Wall -fstack-protector -funroll-loops -ffast-math -fomit-frame-pointer -fstrength-reduce xjack.c  -L. ../libxputty/libxputty/libxputty.a -o xjack -I../libxputty/libxputty/include/ `pkg-config --cflags --libs jack` `pkg-config --cflags --libs cairo x11 sigc++-2.0 fftw3f` -lm -lzita-resampler -lpthread
+//   g++ -O2 -Wall -fstack-protector -funroll-loops -ffast-math -fomit-frame-pointer -fstrength-reduce xjack.c  -L. ../libxputty/libxputty/libxputty.a -o xjack -I../libxputty/libxputty/include/ `pkg-config --cflags --libs jack` `pkg-config --cflags --libs cairo x11 sigc++-2.0 fftw3f` -lm -lpthread
 
 /****************************************************************
  ** class PosixSignalHandler
@@ -154,11 +157,20 @@ public:
     void start(Widget_t *w, tuner *xtuner);
     bool is_running() const noexcept;
     std::condition_variable cv;
+    // redraw the strum readings in the main window as well
+    std::atomic<bool> strum;
+    // the strobe widget, redrawn at display rate while it is set
+    std::atomic<Widget_t*> strobe;
+    // the tuner of the input shown
+    std::atomic<tuner*> source;
 };
 
 
 TunerWatch::TunerWatch() 
-    : _execute(false) {
+    : _execute(false),
+      strum(false),
+      strobe(nullptr),
+      source(nullptr) {
 }
 
 TunerWatch::~TunerWatch() {
@@ -180,13 +192,24 @@ void TunerWatch::start(Widget_t *w, tuner *xtuner) {
         stop();
     };
     _execute.store(true, std::memory_order_release);
-    _thd = std::thread([this, w, xtuner]() {
+    source.store(xtuner, std::memory_order_release);
+    _thd = std::thread([this, w]() {
         while (_execute.load(std::memory_order_acquire)) {
             std::unique_lock<std::mutex> lk(m);
-            cv.wait(lk);
+            Widget_t *s = strobe.load(std::memory_order_acquire);
+            if (s) {
+                // the strobe pattern moves between two estimates as well
+                cv.wait_for(lk, std::chrono::milliseconds(30));
+            } else {
+                cv.wait(lk);
+            }
+            tuner *xtuner = source.load(std::memory_order_acquire);
             XLockDisplay(w->app->dpy);
             adj_set_value(w->adj, (float)xtuner->get_freq((*xtuner)));
-            expose_widget(w);
+            expose_widget(s ? s : w);
+            if (strum.load(std::memory_order_relaxed)) {
+                expose_widget((Widget_t*)w->parent);
+            }
             XFlush(w->app->dpy);
             XUnlockDisplay(w->app->dpy);
         }
@@ -217,6 +240,19 @@ private:
     int visible;
     int mode;
     float ref_freq;
+    int fftw_patient;
+    float hop_ms;
+    int extended_range;
+    int running_acf;
+    int target;
+    int method;
+    int smoothing;
+    int refine;
+    int view;
+    int profile;
+    float low_cut;
+    float high_cut;
+    float sync_budget;
 
     void set_config(const char *name, const char *client_id, bool op_gui);
     void nsm_show_ui();
@@ -228,31 +264,48 @@ private:
     static int jack_srate_callback(jack_nframes_t samplerate, void* arg);
     static int jack_buffersize_callback(jack_nframes_t nframes, void* arg);
     static int jack_process(jack_nframes_t nframes, void *arg);
+    static void jack_thread_init(void *arg);
     static void draw_window(void *w_, void* user_data);
     static void ref_freq_changed(void *w_, void* user_data);
     static void temperament_changed(void *w_, void* user_data);
+    static void target_changed(void *w_, void* user_data);
+    static void method_changed(void *w_, void* user_data);
+    static void view_changed(void *w_, void* user_data);
+    static void profile_changed(void *w_, void* user_data);
+    static void input_changed(void *w_, void* user_data);
+    void update_band();
+    static void draw_strobe(void *w_, void* user_data);
+    void update_view();
+    float nearest_note(float freq);
+    StrobePhase strobe_phase;
+    void update_target();
+    float note_freq(int semitones);
+    enum { STRUM_STRINGS = 6 };
+    float strum_strings[STRUM_STRINGS];
     static void map_callback(void *w_, void* user_data);
     static void unmap_callback(void *w_, void* user_data);
     static void win_configure_callback(void *w_, void* user_data);
     Widget_t* add_my_combobox(Widget_t *w, const char * label, const char** items,
                         size_t len, int active, int x, int y, int width, int height);
 public:
-    XJack(PosixSignalHandler& _xsig, nsmhandler::NsmSignalHandler& _nsmsig);
+    XJack(PosixSignalHandler& _xsig, nsmhandler::NsmSignalHandler& _nsmsig, int _channels);
     ~XJack();
 
     Xputty app;
     Widget_t *w;
-    Widget_t *wid[3];
+    Widget_t *wid[9];
     std::string client_name;
     std::string config_file;
     std::string path;
 
     jack_client_t *client;
-    jack_port_t *in_port;
-    jack_port_t *out_port;
+    int channels;
+    jack_port_t *in_port[tuner_bank::max_channels];
+    jack_port_t *out_port[tuner_bank::max_channels];
 
+    // the tuners of all inputs and the one shown
+    tuner_bank *xbank;
     tuner *xtuner;
-    low_high_cut::Dsp *lhc;
 
     void signal_handle (int sig);
     void exit_handle (int sig);
@@ -263,12 +316,13 @@ public:
     void init_gui();
 };
 
-XJack::XJack(PosixSignalHandler& _xsig, nsmhandler::NsmSignalHandler& _nsmsig)
+XJack::XJack(PosixSignalHandler& _xsig, nsmhandler::NsmSignalHandler& _nsmsig, int _channels)
     : xsig(_xsig),
     nsmsig(_nsmsig),
     twd(),
-    xtuner(NULL),
-    lhc(NULL) {
+    channels(_channels),
+    xbank(NULL),
+    xtuner(NULL) {
     client_name = "XTuner";
     main_x = 0;
     main_y = 0;
@@ -277,6 +331,20 @@ XJack::XJack(PosixSignalHandler& _xsig, nsmhandler::NsmSignalHandler& _nsmsig)
     mode = 0;
     visible = 1;
     ref_freq = 440.0;
+    fftw_patient = 0;
+    hop_ms = 100.0;
+    extended_range = 0;
+    running_acf = 0;
+    target = 0;
+    method = 0;
+    smoothing = 0;
+    refine = 0;
+    view = 0;
+    profile = 0;
+    low_cut = LHC_LOW_CUT;
+    high_cut = LHC_HIGH_CUT;
+    sync_budget = 0.0;
+    strobe_phase = StrobePhase();
     if (getenv("XDG_CONFIG_HOME")) {
         path = getenv("XDG_CONFIG_HOME");
         config_file = path +"/XTuner.conf";
@@ -285,10 +353,11 @@ XJack::XJack(PosixSignalHandler& _xsig, nsmhandler::NsmSignalHandler& _nsmsig)
         config_file = path +"/.config/XTuner.conf";
     }
     
-    if (!xtuner)
-        xtuner = new tuner();
-    if (!lhc)
-        lhc = new low_high_cut::Dsp();
+    if (!xbank) {
+        xbank = new tuner_bank(channels);
+        channels = xbank->size();
+        xtuner = &xbank->channel(0);
+    }
 
     xsig.signal_trigger_quit_by_posix().connect(
         sigc::mem_fun(this, &XJack::signal_handle));
@@ -312,13 +381,41 @@ XJack::XJack(PosixSignalHandler& _xsig, nsmhandler::NsmSignalHandler& _nsmsig)
 
 XJack::~XJack() {
     if (xtuner) {
-        xtuner->activate(false, (*xtuner));
-        delete xtuner;
+        for (int i = 0; i < channels; i++) {
+            tuner& t = xbank->channel(i);
+            // the port name of the channel, the client name alone for one
+            char name[128];
+            snprintf(name, sizeof(name), channels > 1 ? "%s:in_%i" : "%s",
+                client_name.c_str(), i);
+            TrackerStats stats;
+            t.get_stats(t, &stats);
+            if (stats.dropped || stats.late) {
+                fprintf (stderr, "%s: %lu analysis windows, %lu dropped, %lu late, wake up latency avg %.2fms max %.2fms\n",
+                    name, stats.windows, stats.dropped, stats.late,
+                    stats.avg_latency, stats.max_latency);
+            }
+            if (sync_budget > 0) {
+                fprintf (stderr, "%s: analysis in the jack callback %s, %lu overruns, max %.2fms\n",
+                    name, stats.synchronous ? "on" : "off",
+                    stats.sync_overruns, stats.max_sync_cost);
+            }
+            if (smoothing) {
+                FilterStats fstats;
+                t.get_filter_stats(t, &fstats);
+                fprintf (stderr, "%s: pitch filter %lu updates, %lu gated, %lu resets, nis %.2f, innovation %.2f cent rms\n",
+                    name, fstats.updates, fstats.gated, fstats.resets,
+                    fstats.nis, fstats.rms_cents);
+            }
+        }
+        for (int i = 0; i < channels; i++) {
+            xbank->channel(i).activate(false, xbank->channel(i));
+        }
+        delete xbank;
     }
     if (twd.is_running())
         twd.stop();
-    if (lhc)
-        delete lhc;
+    // save the fftw wisdom gathered in this session
+    FftPlanRegistry::instance().shutdown();
 }
 
 /****************************************************************
@@ -337,25 +434,40 @@ int XJack::jack_xrun_callback(void *arg) {
     return 0;
 }
 
+// runs on the notification thread, the tracker for the new rate is
+// built here and swapped in under the running jack thread
 int XJack::jack_srate_callback(jack_nframes_t samplerate, void* arg) {
+    XJack *xjack = (XJack*)arg;
     fprintf (stderr, "Samplerate %iHz \n", samplerate);
+    xjack->xbank->set_sample_rate(samplerate, (*xjack->xbank));
     return 0;
 }
 
+// nothing to resize, the tracker takes any period in chunks of
+// SampleRing::MAX_CHUNK into its own fixed buffers
 int XJack::jack_buffersize_callback(jack_nframes_t nframes, void* arg) {
     fprintf (stderr, "Buffersize is %i samples \n", nframes);
     return 0;
 }
 
+// the jack thread runs the filters and maybe the analysis as well
+void XJack::jack_thread_init(void *arg) {
+    RtConfig::instance().setup_dsp_thread(0);
+    RtConfig::instance().report("jack thread");
+}
+
 int XJack::jack_process(jack_nframes_t nframes, void *arg) {
     XJack *xjack = (XJack*)arg;
-    float *in = static_cast<float *>(jack_port_get_buffer (xjack->in_port, nframes));
-    float *out = static_cast<float *>(jack_port_get_buffer (xjack->out_port, nframes));
-    memcpy (out, in, sizeof (float) * nframes);
-    float buf[nframes];
-    memcpy(buf, in, nframes * sizeof(float));
-    xjack->lhc->compute_static(static_cast<int>(nframes), buf, buf, xjack->lhc);
-    xjack->xtuner->feed_tuner (static_cast<int>(nframes), buf, buf, (*xjack->xtuner));
+    float *in[tuner_bank::max_channels];
+    for (int i = 0; i < xjack->channels; i++) {
+        in[i] = static_cast<float *>(jack_port_get_buffer (xjack->in_port[i], nframes));
+        float *out = static_cast<float *>(jack_port_get_buffer (xjack->out_port[i], nframes));
+        memcpy (out, in[i], sizeof (float) * nframes);
+    }
+    // all inputs in one pass, the bank decimates and band limits them
+    // together and keeps the undecimated input for the high pitch path
+    xjack->xbank->feed (static_cast<int>(nframes), in,
+        jack_last_frame_time(xjack->client), (*xjack->xbank));
 
     return 0;
 }
@@ -368,33 +480,56 @@ void XJack::init_jack() {
         exit (1);
     }
 
-    in_port = jack_port_register(
-                    client, "in_0", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
-    out_port = jack_port_register(
-                    client, "out_0", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    for (int i = 0; i < channels; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "in_%i", i);
+        in_port[i] = jack_port_register(
+                    client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+        snprintf(name, sizeof(name), "out_%i", i);
+        out_port[i] = jack_port_register(
+                    client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    }
 
     jack_set_xrun_callback(client, jack_xrun_callback, this);
     jack_set_sample_rate_callback(client, jack_srate_callback, this);
     jack_set_buffer_size_callback(client, jack_buffersize_callback, this);
     jack_set_process_callback(client, jack_process, this);
+    jack_set_thread_init_callback(client, jack_thread_init, this);
     jack_on_shutdown (client, jack_shutdown, this);
 
-    if (jack_activate (client)) {
-        fprintf (stderr, "cannot activate client");
-        quit(w);
-    }
-
+    // the workers are scheduled relative to jack
     if (!jack_is_realtime(client)) {
         fprintf (stderr, "jack isn't running with realtime priority\n");
+        RtConfig::instance().set_jack_priority(-1);
     } else {
-        fprintf (stderr, "jack running with realtime priority\n");
+        int priority = jack_client_real_time_priority(client);
+        fprintf (stderr, "jack running with realtime priority %i\n", priority);
+        RtConfig::instance().set_jack_priority(priority);
     }
 
     jack_nframes_t samplerate =jack_get_sample_rate(client);
-    lhc->init_static(samplerate, lhc);
-    xtuner->init(samplerate, (*xtuner));
+    FftPlanRegistry::instance().set_patient(fftw_patient);
+    xbank->init(samplerate, (*xbank));
+    for (int i = 0; i < channels; i++) {
+        tuner& t = xbank->channel(i);
+        t.set_hop_time(t, hop_ms);
+        t.set_extended_range(t, extended_range);
+        t.set_running_acf(t, running_acf);
+        t.set_smoothing(t, smoothing);
+        t.set_refine(t, refine);
+        // the inputs share the callback, and so the budget
+        t.set_synchronous(t, sync_budget / channels);
+        // a redraw for any input, it shows the current one
+        t.signal_freq_changed().connect(sigc::mem_fun(this, &XJack::freq_changed_handler));
+    }
+    update_band();
+
+    // the process callback feeds the trackers, so they go first
+    if (jack_activate (client)) {
+        fprintf (stderr, "cannot activate client");
+        quit(w);
+    }
     twd.start(wid[0], xtuner);
-    xtuner->signal_freq_changed().connect(sigc::mem_fun(this, &XJack::freq_changed_handler));
 }
 
 /****************************************************************
@@ -402,6 +537,13 @@ void XJack::init_jack() {
  **    gui stuff
  */
 
+// semitones from A4 of the entries in the target combobox
+static const int target_notes[] = { 0, -41, -36, -31, -26, -29, -24, -19, -14, -10, -5 };
+static const int num_targets = sizeof(target_notes) / sizeof(target_notes[0]);
+// the open strings measured by the "Strum" entry behind them
+static const int strum_notes[] = { -29, -24, -19, -14, -10, -5 };
+static const char *strum_names[] = { "E", "A", "D", "G", "B", "e" };
+
 // draw the window
 void XJack::draw_window(void *w_, void* user_data) {
     Widget_t *w = (Widget_t*)w_;
@@ -452,6 +594,28 @@ void XJack::draw_window(void *w_, void* user_data) {
     cairo_stroke(w->crb);
     cairo_pattern_destroy (pat);
     pat = NULL;
+
+    XJack *xjack = (XJack*)w->parent_struct;
+    if (xjack->target == num_targets) {
+        // strum readings, deviation of each string in cent
+        float freqs[STRUM_STRINGS];
+        int count = xjack->xtuner->get_strum_freqs((*xjack->xtuner), freqs, STRUM_STRINGS);
+        use_text_color_scheme(w, get_color_state(w));
+        cairo_set_font_size (w->crb, w->app->normal_font/w->scale.ascale);
+        const double step = (w->width - 120) / STRUM_STRINGS;
+        for (int i = 0; i < count; i++) {
+            char s[16];
+            if (freqs[i] > 0.0) {
+                snprintf(s, sizeof(s), "%s %+.0f", strum_names[i],
+                         1200.0 * log2(freqs[i] / xjack->strum_strings[i]));
+            } else {
+                snprintf(s, sizeof(s), "%s --", strum_names[i]);
+            }
+            cairo_move_to (w->crb, 60 + i * step, 165 - w->scale.scale_y);
+            cairo_show_text(w->crb, s);
+        }
+        cairo_new_path (w->crb);
+    }
 }
 
 void XJack::set_config(const char *name, const char *client_id, bool op_gui) {
@@ -482,6 +646,21 @@ void XJack::read_config() {
             else if (key.compare("[visible]") == 0) visible = std::stoi(value);
             else if (key.compare("[mode]") == 0) mode = std::stoi(value);
             else if (key.compare("[ref_freq]") == 0) ref_freq = std::stof(value);
+            else if (key.compare("[fftw_patient]") == 0) fftw_patient = std::stoi(value);
+            else if (key.compare("[hop_ms]") == 0) hop_ms = std::stof(value);
+            else if (key.compare("[extended_range]") == 0) extended_range = std::stoi(value);
+            else if (key.compare("[running_acf]") == 0) running_acf = std::stoi(value);
+            else if (key.compare("[target]") == 0) target = std::stoi(value);
+            else if (key.compare("[method]") == 0) method = std::stoi(value);
+            else if (key.compare("[smoothing]") == 0) smoothing = std::stoi(value);
+            else if (key.compare("[refine]") == 0) refine = std::stoi(value);
+            else if (key.compare("[view]") == 0) view = std::stoi(value);
+            else if (key.compare("[profile]") == 0) profile = std::stoi(value);
+            else if (key.compare("[low_cut]") == 0) low_cut = std::stof(value);
+            else if (key.compare("[high_cut]") == 0) high_cut = std::stof(value);
+            else if (key.compare("[sync_budget]") == 0) sync_budget = std::stof(value);
+            else if (key.size() > 2 && key[0] == '[')
+                RtConfig::instance().set(key.substr(1, key.size() - 2), value);
             key.clear();
             value.clear();
         }
@@ -502,6 +681,20 @@ void XJack::save_config() {
          outfile << "[visible] " << visible << std::endl;
          outfile << "[mode] " << mode << std::endl;
          outfile << "[ref_freq] " << ref_freq << std::endl;
+         outfile << "[fftw_patient] " << fftw_patient << std::endl;
+         outfile << "[hop_ms] " << hop_ms << std::endl;
+         outfile << "[extended_range] " << extended_range << std::endl;
+         outfile << "[running_acf] " << running_acf << std::endl;
+         outfile << "[target] " << target << std::endl;
+         outfile << "[method] " << method << std::endl;
+         outfile << "[smoothing] " << smoothing << std::endl;
+         outfile << "[refine] " << refine << std::endl;
+         outfile << "[view] " << view << std::endl;
+         outfile << "[profile] " << profile << std::endl;
+         outfile << "[low_cut] " << low_cut << std::endl;
+         outfile << "[high_cut] " << high_cut << std::endl;
+         outfile << "[sync_budget] " << sync_budget << std::endl;
+         RtConfig::instance().save(outfile);
          outfile.close();
     }
 
@@ -512,6 +705,7 @@ void XJack::save_config() {
 void XJack::nsm_show_ui() {
     XLockDisplay(w->app->dpy);
     widget_show_all(w);
+    update_view();
     visible = 1;
     XFlush(w->app->dpy);
     XMoveWindow(w->app->dpy,w->widget, main_x, main_y);
@@ -531,6 +725,7 @@ void XJack::nsm_hide_ui() {
 void XJack::show_ui(int present) {
     if(present) {
         widget_show_all(w);
+        update_view();
         XMoveWindow(w->app->dpy,w->widget, main_x, main_y);
         if(nsmsig.nsm_session_control)
             nsmsig.trigger_nsm_gui_is_shown();
@@ -594,6 +789,7 @@ void XJack::ref_freq_changed(void *w_, void* user_data) {
     XJack *xjack = (XJack*)w->parent_struct;
     xjack->ref_freq = adj_get_value(w->adj);
     tuner_set_ref_freq(xjack->wid[0],xjack->ref_freq);
+    xjack->update_target();
 }
 
 void XJack::temperament_changed(void *w_, void* user_data) {
@@ -601,6 +797,190 @@ void XJack::temperament_changed(void *w_, void* user_data) {
     XJack *xjack = (XJack*)w->parent_struct;
     xjack->mode = (int)adj_get_value(w->adj);
     tuner_set_temperament(xjack->wid[0],adj_get_value(w->adj));
+    xjack->update_target();
+}
+
+void XJack::target_changed(void *w_, void* user_data) {
+    Widget_t *w = (Widget_t*)w_;
+    XJack *xjack = (XJack*)w->parent_struct;
+    xjack->target = (int)adj_get_value(w->adj);
+    xjack->update_target();
+}
+
+void XJack::method_changed(void *w_, void* user_data) {
+    Widget_t *w = (Widget_t*)w_;
+    XJack *xjack = (XJack*)w->parent_struct;
+    xjack->method = (int)adj_get_value(w->adj);
+    for (int i = 0; i < xjack->channels; i++) {
+        tuner& t = xjack->xbank->channel(i);
+        t.set_estimator(t, xjack->method);
+    }
+}
+
+void XJack::view_changed(void *w_, void* user_data) {
+    Widget_t *w = (Widget_t*)w_;
+    XJack *xjack = (XJack*)w->parent_struct;
+    xjack->view = (int)adj_get_value(w->adj);
+    xjack->update_view();
+}
+
+// band limit corners and largest window per instrument, "Custom"
+// takes [low_cut] and [high_cut] from the config file
+static const struct {
+    const char *name;
+    float low_cut;
+    float high_cut;
+    int fft_size;
+} profiles[] = {
+    { "Default", LHC_LOW_CUT, LHC_HIGH_CUT, 2048 },
+    { "Guitar", 40.0, 1400.0, 2048 },
+    { "Bass", 15.0, 500.0, 4096 },
+    { "Violin", 100.0, 2500.0, 1024 },
+    { "Custom", 0.0, 0.0, 2048 },
+};
+static const int num_profiles = sizeof(profiles) / sizeof(profiles[0]);
+
+// show another input, the target and the strobe move along with it
+void XJack::input_changed(void *w_, void* user_data) {
+    Widget_t *w = (Widget_t*)w_;
+    XJack *xjack = (XJack*)w->parent_struct;
+    tuner *next = &xjack->xbank->channel((int)adj_get_value(w->adj));
+    if (next == xjack->xtuner) return;
+    tuner *prev = xjack->xtuner;
+    prev->set_target((*prev), 0.0);
+    prev->set_strum_strings((*prev), NULL, 0);
+    prev->set_strobe((*prev), 0.0);
+    xjack->strobe_phase = StrobePhase();
+    xjack->xtuner = next;
+    xjack->update_target();
+    xjack->twd.source = next;
+    xjack->twd.cv.notify_one();
+}
+
+void XJack::profile_changed(void *w_, void* user_data) {
+    Widget_t *w = (Widget_t*)w_;
+    XJack *xjack = (XJack*)w->parent_struct;
+    xjack->profile = (int)adj_get_value(w->adj);
+    for (int i = 0; i < xjack->channels; i++) {
+        tuner& t = xjack->xbank->channel(i);
+        t.set_fft_size(t, profiles[xjack->profile].fft_size);
+    }
+    xjack->update_band();
+}
+
+// the tracker computes the coefficients on this thread and hands them
+// over to the jack thread
+void XJack::update_band() {
+    if (profile < 0 || profile >= num_profiles) profile = 0;
+    const bool custom = (profile == num_profiles - 1);
+    for (int i = 0; i < channels; i++) {
+        tuner& t = xbank->channel(i);
+        t.set_band(t, custom ? low_cut : profiles[profile].low_cut,
+                      custom ? high_cut : profiles[profile].high_cut);
+    }
+}
+
+// semitones from A4 as note of the current temperament
+float XJack::note_freq(int semitones) {
+    static const int tet[] = { 12, 19, 24, 31, 53 };
+    int n = tet[(mode < 0 || mode > 4) ? 0 : mode];
+    float steps = round(semitones * n / 12.0);
+    return ref_freq * pow(2.0, steps / n);
+}
+
+// the note of the current temperament closest to freq
+float XJack::nearest_note(float freq) {
+    static const int tet[] = { 12, 19, 24, 31, 53 };
+    int n = tet[(mode < 0 || mode > 4) ? 0 : mode];
+    float steps = round(n * log2(freq / ref_freq));
+    return ref_freq * pow(2.0, steps / n);
+}
+
+// needle or strobe in place of the tuner widget
+void XJack::update_view() {
+    if (view == 1) {
+        widget_hide(wid[0]);
+        widget_show(wid[6]);
+        twd.strobe = wid[6];
+    } else {
+        twd.strobe = nullptr;
+        xtuner->set_strobe((*xtuner), 0.0);
+        strobe_phase = StrobePhase();
+        widget_hide(wid[6]);
+        widget_show(wid[0]);
+    }
+}
+
+// strobe pattern from the newest phase reading, the bands stand
+// still when the note is in tune and move with the deviation
+void XJack::draw_strobe(void *w_, void* user_data) {
+    Widget_t *w = (Widget_t*)w_;
+    XJack *xjack = (XJack*)w->parent_struct;
+    // lock to the target string or else to the nearest note
+    float ref = 0.0;
+    if (xjack->target > 0 && xjack->target < num_targets) {
+        ref = xjack->note_freq(target_notes[xjack->target]);
+    } else {
+        float freq = xjack->xtuner->get_freq((*xjack->xtuner));
+        ref = freq > 0.0 ? xjack->nearest_note(freq) : xjack->strobe_phase.reference;
+    }
+    if (ref != xjack->strobe_phase.reference) {
+        xjack->xtuner->set_strobe((*xjack->xtuner), ref);
+    }
+    StrobePhase p;
+    if (xjack->xtuner->get_strobe((*xjack->xtuner), &p) && p.reference == ref) {
+        xjack->strobe_phase = p;
+    }
+    p = xjack->strobe_phase;
+    if (p.reference != ref) {
+        // the demodulator hasn't caught up yet
+        p.reference = ref;
+        p.level = 0.0;
+    }
+    xjack->strobe_phase.reference = ref;
+
+    const double width = w->width;
+    const double height = w->height;
+    cairo_set_source_rgba(w->crb, 0.05, 0.05, 0.05, 1.0);
+    cairo_rectangle(w->crb, 0, 0, width, height);
+    cairo_fill(w->crb);
+    // fade out with the signal
+    double alpha = p.level > 0.01 ? 1.0 : p.level / 0.01;
+    const int bands = 8;
+    const double period = width / bands;
+    // two rows, the lower one at twice the speed like the octave
+    // band of a mechanical strobe
+    for (int row = 0; row < 2; row++) {
+        double phase = (row + 1) * p.phase;
+        phase -= floor(phase);
+        double y = row * height / 2.0;
+        cairo_set_source_rgba(w->crb, 0.68, 0.44, 0.00, alpha);
+        for (int b = -1; b < bands; b++) {
+            double x = (b + phase) * period;
+            cairo_rectangle(w->crb, x, y + 2, period / 2.0, height / 2.0 - 4);
+        }
+        cairo_fill(w->crb);
+    }
+}
+
+// pass the selected string(s) to the tracker
+void XJack::update_target() {
+    if (target == num_targets) {
+        for (int i = 0; i < STRUM_STRINGS; i++) {
+            strum_strings[i] = note_freq(strum_notes[i]);
+        }
+        xtuner->set_target((*xtuner), 0.0);
+        xtuner->set_strum_strings((*xtuner), strum_strings, STRUM_STRINGS);
+        twd.strum = true;
+        return;
+    }
+    twd.strum = false;
+    xtuner->set_strum_strings((*xtuner), NULL, 0);
+    if (target <= 0 || target > num_targets) {
+        xtuner->set_target((*xtuner), 0.0);
+        return;
+    }
+    xtuner->set_target((*xtuner), note_freq(target_notes[target]));
 }
 
 // shortcut to create comboboxe with entrys
@@ -620,6 +1000,13 @@ void dummy_callback(void *w_, void* user_data) {
 }
 
 void XJack::init_gui() {
+    // the tracker is made for the profile before anything is set on it
+    if (profile < 0 || profile >= num_profiles) profile = 0;
+    for (int i = 0; i < channels; i++) {
+        tuner& t = xbank->channel(i);
+        t.set_fft_size(t, profiles[profile].fft_size);
+    }
+
     app.color_scheme->normal.text[0] = 0.68;
     app.color_scheme->normal.text[1] = 0.44;
     app.color_scheme->normal.text[2] = 0.00;
@@ -670,9 +1057,66 @@ void XJack::init_gui() {
     wid[2]->scale.gravity = NONE;
     adj_set_value(wid[2]->adj, ref_freq);
     tuner_set_ref_freq(wid[0],adj_get_value(wid[2]->adj));
+
+    const char* strings[] = {"Off", "E1", "A1", "D2", "G2", "E2", "A2", "D3", "G3", "B3", "E4", "Strum"};
+    len = sizeof(strings) / sizeof(strings[0]);
+    wid[3] = add_my_combobox(w, "Target", strings, len, 0, 230, 20, 60, 25);
+    wid[3]->func.value_changed_callback = target_changed;
+    wid[3]->parent_struct = this;
+    wid[3]->scale.gravity = NONE;
+    combobox_set_active_entry(wid[3],target);
+    update_target();
+
+    wid[4] = add_combobox(w, "Method", 300, 20, 70, 25);
+    for (int i = 0; i < xtuner->estimator_count(); i++) {
+        combobox_add_entry(wid[4], xtuner->estimator_name(i));
+    }
+    wid[4]->func.value_changed_callback = method_changed;
+    wid[4]->parent_struct = this;
+    wid[4]->scale.gravity = NONE;
+    combobox_set_active_entry(wid[4],method);
+    for (int i = 0; i < channels; i++) {
+        tuner& t = xbank->channel(i);
+        t.set_estimator(t, method);
+    }
+
+    const char* views[] = {"Needle", "Strobe"};
+    len = sizeof(views) / sizeof(views[0]);
+    wid[5] = add_my_combobox(w, "View", views, len, 0, 380, 20, 60, 25);
+    wid[5]->func.value_changed_callback = view_changed;
+    wid[5]->parent_struct = this;
+    wid[5]->scale.gravity = NONE;
+    combobox_set_active_entry(wid[5],view);
+
+    wid[6] = create_widget(&app, w, 60, 60, 400, 80);
+    wid[6]->scale.gravity = NORTHWEST;
+    wid[6]->parent_struct = this;
+    wid[6]->func.expose_callback = draw_strobe;
+
+    wid[7] = add_combobox(w, "Profile", 445, 20, 65, 25);
+    for (int i = 0; i < num_profiles; i++) {
+        combobox_add_entry(wid[7], profiles[i].name);
+    }
+    wid[7]->func.value_changed_callback = profile_changed;
+    wid[7]->parent_struct = this;
+    wid[7]->scale.gravity = NONE;
+    combobox_set_active_entry(wid[7],profile);
+
+    wid[8] = NULL;
+    if (channels > 1) {
+        wid[8] = add_combobox(w, "Input", 5, 20, 50, 25);
+        for (int i = 0; i < channels; i++) {
+            char s[8];
+            snprintf(s, sizeof(s), "%i", i + 1);
+            combobox_add_entry(wid[8], s);
+        }
+        wid[8]->func.value_changed_callback = input_changed;
+        wid[8]->parent_struct = this;
+        wid[8]->scale.gravity = NONE;
+        combobox_set_active_entry(wid[8],0);
+    }
     XResizeWindow (w->app->dpy, w->widget, main_w, main_h);
     if (!nsmsig.nsm_session_control || visible) show_ui(1);
-    
 }
 
 /****************************************************************
@@ -717,15 +1161,44 @@ int main (int argc, char *argv[]) {
     if(0 == XInitThreads()) 
         fprintf(stderr, "Warning: XInitThreads() failed\n");
     
+    // --channels N serves N inputs from one jack client
+    int channels = 1;
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], "--channels") == 0) {
+            channels = atoi(argv[i + 1]);
+        }
+    }
+    if (channels < 1 || channels > tuner_bank::max_channels) {
+        fprintf(stderr, "--channels takes 1 to %i inputs\n", tuner_bank::max_channels);
+        channels = channels < 1 ? 1 : tuner_bank::max_channels;
+    }
+
     PosixSignalHandler xsig;
     nsmhandler::NsmSignalHandler nsmsig;
-    XJack xjack (xsig, nsmsig);
+    XJack xjack (xsig, nsmsig, channels);
     nsmhandler::NsmHandler nsmh(&nsmsig);
 
     nsmsig.nsm_session_control = nsmh.check_nsm(xjack.client_name.c_str(), argv);
 
     xjack.read_config();
 
+    // the RtConfig keys as --key value, e.g. --rt-priority -10 or
+    // --cpus 2,3, take over the config file
+    for (int i = 1; i < argc - 1; i++) {
+        if (strncmp(argv[i], "--", 2) != 0 || strcmp(argv[i], "--channels") == 0) {
+            continue;
+        }
+        std::string key(argv[i] + 2);
+        for (size_t j = 0; j < key.size(); j++) {
+            if (key[j] == '-') key[j] = '_';
+        }
+        if (!RtConfig::instance().set(key, argv[i + 1])) {
+            fprintf(stderr, "%s %s: unknown option or bad value\n", argv[i], argv[i + 1]);
+        }
+        i++;
+    }
+    RtConfig::instance().lock_memory();
+
     main_init(&xjack.app);
 
     xjack.init_gui();
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2020, 2010 Hermann Meyer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * --------------------------------------------------------------------------
+ */
+
+/****************************************************************
+ ** zoom refiner
+ **
+ ** sharpens a coarse pitch estimate on a long window. The spectrum
+ ** is only evaluated right around the fundamental and its first
+ ** harmonics, zooming in three times by a factor of four, so the
+ ** resolution doesn't depend on the bin width of an FFT.
+ */
+
+#pragma once
+
+#ifndef SRC_HEADERS_ZOOM_REFINER_H_
+#define SRC_HEADERS_ZOOM_REFINER_H_
+
+#include <math.h>
+#include "pitch_estimators.h"
+
+
+/* ------------- ZoomRefiner ------------- */
+
+class ZoomRefiner {
+ public:
+    enum {
+        MIN_WINDOW = 1024,
+        MAX_WINDOW = 4096,  // about 180ms at the analysis rate
+        HARMONICS = 3,
+        ZOOMS = 3,
+    };
+
+    ZoomRefiner() : m_size(0) {}
+
+    // window size for a pitch of freq with fresh samples available,
+    // 0 when too short for at least 8 periods
+    static int window_size(float freq, int sampleRate, unsigned int fresh) {
+        int n = MAX_WINDOW;
+        while (n > MIN_WINDOW && static_cast<unsigned int>(n) > fresh) {
+            n /= 2;
+        }
+        if (static_cast<unsigned int>(n) > fresh || n < 8 * sampleRate / freq) {
+            return 0;
+        }
+        return n;
+    }
+
+    // refine the pitch freq on the n samples at input. Returns the
+    // refined pitch, or freq when the spectrum doesn't confirm it.
+    float refine(const float *input, int n, float freq, int sampleRate) {
+        if (n != m_size) {
+            for (int j = 0; j < n; j++) {
+                m_hann[j] = 0.5f - 0.5f * cosf(2.0f * M_PI * j / (n - 1));
+            }
+            m_size = n;
+        }
+        for (int j = 0; j < n; j++) {
+            m_windowed[j] = input[j] * m_hann[j];
+        }
+        const float bin = static_cast<float>(sampleRate) / n;
+        float f[HARMONICS];
+        double level[HARMONICS];
+        int count = 0;
+        int strongest = 0;
+        for (int h = 1; h <= HARMONICS && h * freq < 0.5f * sampleRate - 2 * bin; h++) {
+            f[count] = find_peak(h * freq, bin, sampleRate, &level[count]) / h;
+            if (level[count] > level[strongest]) {
+                strongest = count;
+            }
+            count++;
+        }
+        if (!count) {
+            return freq;
+        }
+        // the fundamental as long as it is clearly there, the
+        // harmonics of a stiff string are a little sharp
+        float x = level[0] >= 0.1 * level[strongest] ? f[0] : f[strongest];
+        // beyond a quarter semitone it found something else
+        if (fabsf(log2f(x / freq)) > 1.0f / 48) {
+            return freq;
+        }
+        return x;
+    }
+
+ private:
+    // power of the windowed signal at frequency f (Goertzel)
+    double power(float f, int sampleRate) const {
+        const double w = 2.0 * M_PI * f / sampleRate;
+        const double c = 2.0 * cos(w);
+        double s1 = 0.0, s2 = 0.0;
+        for (int j = 0; j < m_size; j++) {
+            double s0 = m_windowed[j] + c * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        return s1 * s1 + s2 * s2 - c * s1 * s2;
+    }
+
+    // the peak next to f, starting with a step of half a bin
+    float find_peak(float f, float bin, int sampleRate, double *level) const {
+        const double eps = 1e-20;
+        float step = 0.5f * bin;
+        double p0 = power(f, sampleRate);
+        for (int z = 0; z < ZOOMS; z++) {
+            double pl = power(f - step, sampleRate);
+            double pr = power(f + step, sampleRate);
+            // walk uphill while the peak lies outside
+            for (int k = 0; k < 4 && (pl > p0 || pr > p0); k++) {
+                if (pl > pr) {
+                    pr = p0;
+                    p0 = pl;
+                    f -= step;
+                    pl = power(f - step, sampleRate);
+                } else {
+                    pl = p0;
+                    p0 = pr;
+                    f += step;
+                    pr = power(f + step, sampleRate);
+                }
+            }
+            float x;
+            parabolaTurningPoint(log(pl + eps), log(p0 + eps), log(pr + eps), 0.0, &x);
+            x = std::max(-1.0f, std::min(1.0f, x));
+            f += x * step;
+            step *= 0.25f;
+            p0 = power(f, sampleRate);
+        }
+        *level = p0;
+        return f;
+    }
+
+    int             m_size;
+    float           m_hann[MAX_WINDOW];
+    float           m_windowed[MAX_WINDOW];
+};
+
+
+#endif  // SRC_HEADERS_ZOOM_REFINER_H_